@@ -1,6 +1,7 @@
 #ifndef BRICK_COMPONENT_HPP
 #define BRICK_COMPONENT_HPP
 
+#include <Stick/DynamicArray.hpp>
 #include <Stick/String.hpp>
 #include <type_traits>
 
@@ -13,14 +14,94 @@ namespace brick
 
         using ValueType = T;
 
+        // Components with an empty value type are tags (i.e. Dead or Selected). The hub
+        // does not create a storage for them, they only take their bit in the component
+        // bitset of the entity.
+        static constexpr bool IsTag = std::is_empty<T>::value;
+
         static const stick::String & name()
         {
             return N::name();
         }
+
+        static constexpr const char * cString()
+        {
+            return N::cString();
+        }
+
+        // compile time hash of the component name. Unlike the component id used by
+        // the hub it does not depend on the order in which components are first used,
+        // so it is stable across processes, i.e. for serialization.
+        static constexpr stick::UInt64 hash()
+        {
+            return N::hash();
+        }
     };
 
+    template<class N, class T>
+    constexpr bool Component<N, T>::IsTag;
+
     namespace detail
     {
+        template<class T>
+        struct IsCopyConstructible
+        {
+            static constexpr bool Value = std::is_copy_constructible<T>::value;
+        };
+
+        //DynamicArray always declares a copy constructor
+        template<class T>
+        struct IsCopyConstructible<stick::DynamicArray<T> >
+        {
+            static constexpr bool Value = std::is_copy_constructible<T>::value;
+        };
+    }
+
+    // Decides if and how a component is copied when its entity is cloned. Copy
+    // constructible components are copied, all others are skipped and the clone
+    // does not get them. Specialize it for move only components that can still be
+    // duplicated, i.e. ones holding a UniquePtr:
+    //
+    //     template<>
+    //     struct CloneTrait<Mesh>
+    //     {
+    //         static constexpr bool IsClonable = true;
+    //         static Mesh clone(const Mesh & _mesh);
+    //     };
+    template<class T, class Enable = void>
+    struct CloneTrait
+    {
+        static constexpr bool IsClonable = false;
+    };
+
+    template<class T>
+    struct CloneTrait<T, typename std::enable_if<detail::IsCopyConstructible<T>::Value>::type>
+    {
+        static constexpr bool IsClonable = true;
+
+        static const T & clone(const T & _value)
+        {
+            return _value;
+        }
+    };
+
+    namespace detail
+    {
+        constexpr stick::UInt64 FNVOffsetBasis = 14695981039346656037ull;
+        constexpr stick::UInt64 FNVPrime = 1099511628211ull;
+
+        // 64 bit FNV-1a
+        constexpr stick::UInt64 fnv1a(stick::UInt64 _hash)
+        {
+            return _hash;
+        }
+
+        template<class...Cs>
+        constexpr stick::UInt64 fnv1a(stick::UInt64 _hash, char _c, Cs..._cs)
+        {
+            return fnv1a((_hash ^ static_cast<stick::UInt64>(static_cast<unsigned char>(_c))) * FNVPrime, _cs...);
+        }
+
         template<char... CHARS>
         struct ComponentNameHolder
         {
@@ -29,8 +110,23 @@ namespace brick
                 static const stick::String str = stick::String::concat(CHARS...);
                 return str;
             }
+
+            static constexpr const char * cString()
+            {
+                return s_chars;
+            }
+
+            static constexpr stick::UInt64 hash()
+            {
+                return fnv1a(FNVOffsetBasis, CHARS...);
+            }
+
+            static constexpr char s_chars[sizeof...(CHARS) + 1] = {CHARS..., '\0'};
         };
 
+        template<char... CHARS>
+        constexpr char ComponentNameHolder<CHARS...>::s_chars[];
+
         template< typename, char ... >
         struct ComponentNameBuilder;
 
@@ -0,0 +1,190 @@
+#ifndef BRICK_COMPONENTBUFFER_HPP
+#define BRICK_COMPONENTBUFFER_HPP
+
+#include <Brick/Component.hpp>
+#include <Brick/SharedPage.hpp>
+#include <Stick/DynamicArray.hpp>
+
+#include <atomic>
+
+namespace brick
+{
+    class ComponentBufferBase
+    {
+    public:
+
+        virtual ~ComponentBufferBase()
+        {
+        }
+    };
+
+    // Published copies of one component type, see Hub::componentBuffer() and
+    // Hub::swapBuffers(). The simulation keeps writing the regular component storage
+    // while a single reader thread (i.e. the renderer) iterates the most recently
+    // published state. Internally there are three buffers: the one being read, the
+    // most recently published one and a spare one that the next publish fills, so
+    // neither side ever waits for the other. A buffer does not copy the values, it
+    // holds references to the immutable page copies of the storage (see SharedPage),
+    // so a publish only copies the pages that changed since they were last shared and
+    // compares the others. T needs to be clonable, see CloneTrait.
+    template<class T>
+    class ComponentBuffer : public ComponentBufferBase
+    {
+        friend class Hub;
+
+    public:
+
+        static_assert(CloneTrait<T>::IsClonable, "buffered components need to be clonable");
+
+        struct Item
+        {
+            EntityID entity;
+            const T & value;
+        };
+
+        class Iter
+        {
+        public:
+
+            Iter(const ComponentBuffer * _buffer, stick::Size _index) :
+                m_buffer(_buffer),
+                m_index(_index)
+            {
+            }
+
+            Iter & operator++()
+            {
+                ++m_index;
+                return *this;
+            }
+
+            Iter operator++(int)
+            {
+                Iter ret = *this;
+                ++m_index;
+                return ret;
+            }
+
+            bool operator == (const Iter & _other) const
+            {
+                return m_index == _other.m_index;
+            }
+
+            bool operator != (const Iter & _other) const
+            {
+                return m_index != _other.m_index;
+            }
+
+            Item operator * () const
+            {
+                const Page * page = m_buffer->m_buffers[m_buffer->m_read].pages[m_index / ComponentPageSize];
+                stick::Size i = m_index % ComponentPageSize;
+                return {page->entities[i], page->values()[i]};
+            }
+
+        private:
+
+            const ComponentBuffer * m_buffer;
+            stick::Size m_index;
+        };
+
+
+        ComponentBuffer(stick::Allocator & _alloc) :
+            m_buffers{Buffer(_alloc), Buffer(_alloc), Buffer(_alloc)},
+            m_write(0),
+            m_read(1),
+            m_ready(2)
+        {
+        }
+
+        ~ComponentBuffer()
+        {
+            for (Buffer & b : m_buffers)
+                releasePages(b);
+        }
+
+        // Reader side. Switches to the most recently published state, returns false if
+        // nothing was published since the last call. The values stay valid and unchanged
+        // until the next call.
+        bool acquire()
+        {
+            if (!(m_ready.load(std::memory_order_relaxed) & NewBit))
+                return false;
+            m_read = m_ready.exchange(m_read, std::memory_order_acq_rel) & ~NewBit;
+            return true;
+        }
+
+        // number of values of the acquired state
+        stick::Size count() const
+        {
+            return m_buffers[m_read].count;
+        }
+
+        // the published generation of the acquired state, 0 if nothing was acquired yet
+        stick::Size generation() const
+        {
+            return m_buffers[m_read].generation;
+        }
+
+        Iter begin() const
+        {
+            return Iter(this, 0);
+        }
+
+        Iter end() const
+        {
+            return Iter(this, count());
+        }
+
+    private:
+
+        static constexpr stick::Size NewBit = static_cast<stick::Size>(1) << (sizeof(stick::Size) * 8 - 1);
+
+        using Page = SharedPage<T>;
+
+        struct Buffer
+        {
+            Buffer(stick::Allocator & _alloc) :
+                pages(_alloc),
+                count(0),
+                generation(0)
+            {
+            }
+
+            stick::DynamicArray<Page *> pages;
+            stick::Size count;
+            stick::Size generation;
+        };
+
+        // Writer side. Makes the spare buffer share the current pages of _storage and
+        // publishes it. The pages the spare buffer held before are released here, on the
+        // writer thread, as the reader can't be using them anymore.
+        template<class S>
+        void publish(S & _storage, stick::Size _generation, stick::Allocator & _alloc)
+        {
+            Buffer & b = m_buffers[m_write];
+            releasePages(b);
+            _storage.sharePages(b.pages, _alloc);
+            b.count = _storage.count();
+            b.generation = _generation;
+            m_write = m_ready.exchange(m_write | NewBit, std::memory_order_acq_rel) & ~NewBit;
+        }
+
+        static void releasePages(Buffer & _buffer)
+        {
+            for (Page * page : _buffer.pages)
+                Page::release(page);
+            _buffer.pages.clear();
+        }
+
+        Buffer m_buffers[3];
+        // only touched by the writer
+        stick::Size m_write;
+        // only touched by the reader
+        stick::Size m_read;
+        // the published buffer, NewBit is set if the reader did not acquire it yet
+        std::atomic<stick::Size> m_ready;
+    };
+}
+
+#endif //BRICK_COMPONENTBUFFER_HPP
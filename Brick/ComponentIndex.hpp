@@ -0,0 +1,312 @@
+#ifndef BRICK_COMPONENTINDEX_HPP
+#define BRICK_COMPONENTINDEX_HPP
+
+#include <Brick/Component.hpp>
+#include <Brick/ComponentObserver.hpp>
+#include <Brick/Delta.hpp>
+#include <Stick/DynamicArray.hpp>
+#include <Stick/String.hpp>
+#include <Stick/TypeInfo.hpp>
+
+#include <type_traits>
+#include <utility>
+
+namespace brick
+{
+    // Hashes the keys of a ComponentIndex, equal keys need to have equal hashes. Integers,
+    // enums, pointers and Strings are supported out of the box, specialize it for other key
+    // types:
+    //
+    // template<>
+    // struct IndexKeyTrait<Guid>
+    // {
+    //     static constexpr bool IsKey = true;
+    //
+    //     static stick::UInt64 hash(const Guid & _guid);
+    // };
+    template<class K, class Enable = void>
+    struct IndexKeyTrait
+    {
+        static constexpr bool IsKey = false;
+    };
+
+    template<class K>
+    struct IndexKeyTrait<K, typename std::enable_if<
+        std::is_integral<K>::value || std::is_enum<K>::value || std::is_pointer<K>::value>::type>
+    {
+        static constexpr bool IsKey = true;
+
+        static stick::UInt64 hash(const K & _key)
+        {
+            return hashBytes(&_key, sizeof(K), detail::FNVOffsetBasis);
+        }
+    };
+
+    template<>
+    struct IndexKeyTrait<stick::String>
+    {
+        static constexpr bool IsKey = true;
+
+        static stick::UInt64 hash(const stick::String & _key)
+        {
+            return hashBytes(_key.cString(), _key.length(), detail::FNVOffsetBasis);
+        }
+    };
+
+    namespace detail
+    {
+        // keeps a function parameter out of template argument deduction
+        template<class T>
+        struct NonDeduced
+        {
+            using Type = T;
+        };
+    }
+
+    // Type erased part of a ComponentIndex so the hub can keep the indices of all components
+    // in one array.
+    class STICK_API ComponentIndexBase : public ComponentObserver
+    {
+    public:
+
+        ComponentIndexBase(stick::TypeID _keyTypeID, bool _bUnique) :
+            m_keyTypeID(_keyTypeID),
+            m_bUnique(_bUnique)
+        {
+        }
+
+        stick::TypeID keyTypeID() const
+        {
+            return m_keyTypeID;
+        }
+
+        bool isUnique() const
+        {
+            return m_bUnique;
+        }
+
+    private:
+
+        stick::TypeID m_keyTypeID;
+        bool m_bUnique;
+    };
+
+    // Hash table from the keys of the components of one type to the entities that have them,
+    // see Hub::enableIndex(). Collisions are chained through the entries, which live in one
+    // array that is kept dense by moving the last entry into the gaps of removed ones. The
+    // key of every indexed entity is kept so it can be unlinked when the component changes.
+    template<class K>
+    class ComponentIndex : public ComponentIndexBase
+    {
+    public:
+
+        static_assert(IndexKeyTrait<K>::IsKey, "IndexKeyTrait needs to be specialized for this key type");
+
+        using KeyType = K;
+
+
+        ComponentIndex(stick::Allocator & _alloc, bool _bUnique) :
+            ComponentIndexBase(stick::TypeInfoT<K>::typeID(), _bUnique),
+            m_buckets(_alloc),
+            m_entries(_alloc),
+            m_entityEntries(_alloc)
+        {
+        }
+
+        ComponentIndex(const ComponentIndex &) = delete;
+
+        ComponentIndex & operator = (const ComponentIndex &) = delete;
+
+        // adds _entity or updates its key. Unique indices assert that no other entity has _key.
+        void insert(EntityID _entity, K _key)
+        {
+            stick::UInt64 hash = IndexKeyTrait<K>::hash(_key);
+            if (contains(_entity))
+            {
+                Entry & e = m_entries[m_entityEntries[_entity]];
+                if (e.hash == hash && e.key == _key)
+                    return;
+                remove(_entity);
+            }
+            STICK_ASSERT(!isUnique() || findFirst(_key) == InvalidEntityID);
+
+            while (m_entityEntries.count() <= _entity)
+                m_entityEntries.append(InvalidSlot);
+            //keep at most one entry per bucket on average
+            if (m_entries.count() + 1 > m_buckets.count())
+                rehash(m_buckets.count() ? m_buckets.count() * 2 : 64);
+
+            stick::UInt32 index = static_cast<stick::UInt32>(m_entries.count());
+            stick::UInt32 & bucket = m_buckets[hash & (m_buckets.count() - 1)];
+            m_entries.append({std::move(_key), hash, _entity, InvalidSlot, bucket});
+            if (bucket != InvalidSlot)
+                m_entries[bucket].prev = index;
+            bucket = index;
+            m_entityEntries[_entity] = index;
+        }
+
+        void remove(EntityID _entity)
+        {
+            if (!contains(_entity))
+                return;
+            stick::UInt32 index = m_entityEntries[_entity];
+            unlink(index);
+            m_entityEntries[_entity] = InvalidSlot;
+
+            //move the last entry into the gap
+            stick::UInt32 last = static_cast<stick::UInt32>(m_entries.count() - 1);
+            if (index != last)
+            {
+                unlink(last);
+                m_entries[index] = std::move(m_entries[last]);
+                link(index);
+                m_entityEntries[m_entries[index].entity] = index;
+            }
+            m_entries.removeLast();
+        }
+
+        void clear()
+        {
+            for (stick::UInt32 & bucket : m_buckets)
+                bucket = InvalidSlot;
+            m_entries.clear();
+            m_entityEntries.clear();
+        }
+
+        bool contains(EntityID _entity) const
+        {
+            return _entity < m_entityEntries.count() && m_entityEntries[_entity] != InvalidSlot;
+        }
+
+        // the key _entity is indexed by, _entity needs to be indexed.
+        const K & key(EntityID _entity) const
+        {
+            STICK_ASSERT(contains(_entity));
+            return m_entries[m_entityEntries[_entity]].key;
+        }
+
+        // an entity with _key, InvalidEntityID if there is none.
+        EntityID findFirst(const K & _key) const
+        {
+            EntityID ret = InvalidEntityID;
+            visit(_key, [&](EntityID _entity)
+            {
+                if (ret == InvalidEntityID)
+                    ret = _entity;
+            });
+            return ret;
+        }
+
+        // calls _fn(EntityID) for every entity with _key.
+        template<class F>
+        void visit(const K & _key, F _fn) const
+        {
+            if (!m_buckets.count())
+                return;
+            stick::UInt64 hash = IndexKeyTrait<K>::hash(_key);
+            for (stick::UInt32 i = m_buckets[hash & (m_buckets.count() - 1)]; i != InvalidSlot; i = m_entries[i].next)
+            {
+                if (m_entries[i].hash == hash && m_entries[i].key == _key)
+                    _fn(m_entries[i].entity);
+            }
+        }
+
+        // number of indexed entities
+        stick::Size count() const
+        {
+            return m_entries.count();
+        }
+
+        void componentRemoved(EntityID _entity)
+        {
+            remove(_entity);
+        }
+
+        void componentsReset()
+        {
+            clear();
+        }
+
+    private:
+
+        static constexpr stick::UInt32 InvalidSlot = static_cast<stick::UInt32>(-1);
+
+        struct Entry
+        {
+            K key;
+            stick::UInt64 hash;
+            EntityID entity;
+            stick::UInt32 prev;
+            stick::UInt32 next;
+        };
+
+        stick::UInt32 & bucketFor(const Entry & _entry)
+        {
+            return m_buckets[_entry.hash & (m_buckets.count() - 1)];
+        }
+
+        void link(stick::UInt32 _index)
+        {
+            Entry & e = m_entries[_index];
+            stick::UInt32 & bucket = bucketFor(e);
+            e.prev = InvalidSlot;
+            e.next = bucket;
+            if (bucket != InvalidSlot)
+                m_entries[bucket].prev = _index;
+            bucket = _index;
+        }
+
+        void unlink(stick::UInt32 _index)
+        {
+            Entry & e = m_entries[_index];
+            if (e.prev != InvalidSlot)
+                m_entries[e.prev].next = e.next;
+            else
+                bucketFor(e) = e.next;
+            if (e.next != InvalidSlot)
+                m_entries[e.next].prev = e.prev;
+        }
+
+        void rehash(stick::Size _bucketCount)
+        {
+            m_buckets.clear();
+            for (stick::Size i = 0; i < _bucketCount; ++i)
+                m_buckets.append(InvalidSlot);
+            for (stick::UInt32 i = 0; i < m_entries.count(); ++i)
+                link(i);
+        }
+
+        // first entry of each chain, the bucket count is a power of two
+        stick::DynamicArray<stick::UInt32> m_buckets;
+        stick::DynamicArray<Entry> m_entries;
+        // indexed by entity id
+        stick::DynamicArray<stick::UInt32> m_entityEntries;
+    };
+
+    template<class K>
+    constexpr stick::UInt32 ComponentIndex<K>::InvalidSlot;
+
+    // Feeds a ComponentIndex with the keys _keyFn extracts from the components T.
+    template<class T, class K, class F>
+    class ComponentIndexT : public ComponentIndex<K>
+    {
+    public:
+
+        ComponentIndexT(stick::Allocator & _alloc, bool _bUnique, F _keyFn) :
+            ComponentIndex<K>(_alloc, _bUnique),
+            m_keyFn(std::move(_keyFn))
+        {
+        }
+
+        void componentSet(EntityID _entity, const void * _value)
+        {
+            this->insert(_entity, m_keyFn(*static_cast<const T *>(_value)));
+        }
+
+    private:
+
+        F m_keyFn;
+    };
+}
+
+#endif //BRICK_COMPONENTINDEX_HPP
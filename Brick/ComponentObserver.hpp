@@ -0,0 +1,31 @@
+#ifndef BRICK_COMPONENTOBSERVER_HPP
+#define BRICK_COMPONENTOBSERVER_HPP
+
+#include <Brick/EntityID.hpp>
+
+namespace brick
+{
+    // Gets told about the changes to the components of one type, see Hub::addObserver().
+    // Components are reported when they are set through the hub (set(), emplace(), replace(),
+    // clone, migrate, splice) and removed (removeComponent(), destroy()). Writes through the
+    // references returned by get() are not seen. Operations that change a storage as a whole
+    // (clear(), compact(), restore(), applyDelta()) call componentsReset() and report all
+    // remaining components again.
+    class STICK_API ComponentObserver
+    {
+    public:
+
+        virtual ~ComponentObserver()
+        {
+        }
+
+        // _value points to the ValueType of the observed component.
+        virtual void componentSet(EntityID _entity, const void * _value) = 0;
+
+        virtual void componentRemoved(EntityID _entity) = 0;
+
+        virtual void componentsReset() = 0;
+    };
+}
+
+#endif //BRICK_COMPONENTOBSERVER_HPP
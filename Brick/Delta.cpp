@@ -0,0 +1,211 @@
+#include <Brick/Delta.hpp>
+#include <Brick/Component.hpp>
+
+#include <cstring>
+
+namespace brick
+{
+    using namespace stick;
+
+    namespace
+    {
+        // a literal run of the XOR+RLE encoding ends at this many zero bytes in a row,
+        // shorter zero runs are cheaper to keep as literals
+        constexpr Size MinZeroRun = 4;
+
+        UInt8 baseByte(const UInt8 * _base, Size _baseByteCount, Size _index)
+        {
+            return _index < _baseByteCount ? _base[_index] : 0;
+        }
+    }
+
+    UInt64 hashBytes(const void * _data, Size _byteCount, UInt64 _hash)
+    {
+        const UInt8 * data = static_cast<const UInt8 *>(_data);
+        for (Size i = 0; i < _byteCount; ++i)
+            _hash = (_hash ^ data[i]) * detail::FNVPrime;
+        return _hash;
+    }
+
+    DeltaWriter::DeltaWriter(DynamicArray<UInt8> & _bytes) :
+        m_bytes(&_bytes)
+    {
+    }
+
+    void DeltaWriter::writeUInt8(UInt8 _value)
+    {
+        m_bytes->append(_value);
+    }
+
+    void DeltaWriter::writeUInt64(UInt64 _value)
+    {
+        writeBytes(&_value, sizeof(_value));
+    }
+
+    void DeltaWriter::writeVarint(UInt64 _value)
+    {
+        while (_value >= 0x80)
+        {
+            m_bytes->append(static_cast<UInt8>(_value | 0x80));
+            _value >>= 7;
+        }
+        m_bytes->append(static_cast<UInt8>(_value));
+    }
+
+    void DeltaWriter::writeBytes(const void * _data, Size _byteCount)
+    {
+        if (!_byteCount)
+            return;
+        Size offset = m_bytes->count();
+        m_bytes->resize(offset + _byteCount);
+        std::memcpy(&(*m_bytes)[offset], _data, _byteCount);
+    }
+
+    void DeltaWriter::writeXorRle(const void * _data, Size _byteCount, const void * _base, Size _baseByteCount)
+    {
+        const UInt8 * data = static_cast<const UInt8 *>(_data);
+        const UInt8 * base = static_cast<const UInt8 *>(_base);
+        auto diff = [&](Size _index)
+        {
+            return static_cast<UInt8>(data[_index] ^ baseByte(base, _baseByteCount, _index));
+        };
+
+        Size i = 0;
+        while (i < _byteCount)
+        {
+            Size zeros = 0;
+            while (i + zeros < _byteCount && !diff(i + zeros))
+                ++zeros;
+            i += zeros;
+
+            Size end = i;
+            while (end < _byteCount)
+            {
+                if (diff(end))
+                {
+                    ++end;
+                    continue;
+                }
+                Size z = 0;
+                while (end + z < _byteCount && z < MinZeroRun && !diff(end + z))
+                    ++z;
+                if (z == MinZeroRun || end + z == _byteCount)
+                    break;
+                end += z;
+            }
+
+            writeVarint(zeros);
+            writeVarint(end - i);
+            for (; i < end; ++i)
+                m_bytes->append(diff(i));
+        }
+    }
+
+    DeltaReader::DeltaReader() :
+        m_pos(nullptr),
+        m_end(nullptr)
+    {
+    }
+
+    DeltaReader::DeltaReader(const UInt8 * _data, Size _byteCount) :
+        m_pos(_data),
+        m_end(_data + _byteCount)
+    {
+    }
+
+    bool DeltaReader::readUInt8(UInt8 & _out)
+    {
+        if (m_pos == m_end)
+            return false;
+        _out = *m_pos++;
+        return true;
+    }
+
+    bool DeltaReader::readUInt64(UInt64 & _out)
+    {
+        return readBytes(&_out, sizeof(_out));
+    }
+
+    bool DeltaReader::readVarint(UInt64 & _out)
+    {
+        UInt64 value = 0;
+        for (Size shift = 0; shift < 64; shift += 7)
+        {
+            if (m_pos == m_end)
+                return false;
+            UInt8 byte = *m_pos++;
+            value |= static_cast<UInt64>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                _out = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool DeltaReader::readBytes(void * _out, Size _byteCount)
+    {
+        if (static_cast<Size>(m_end - m_pos) < _byteCount)
+            return false;
+        if (_byteCount)
+            std::memcpy(_out, m_pos, _byteCount);
+        m_pos += _byteCount;
+        return true;
+    }
+
+    bool DeltaReader::skipBytes(Size _byteCount)
+    {
+        if (static_cast<Size>(m_end - m_pos) < _byteCount)
+            return false;
+        m_pos += _byteCount;
+        return true;
+    }
+
+    bool DeltaReader::readXorRle(void * _out, Size _byteCount, const void * _base, Size _baseByteCount)
+    {
+        UInt8 * out = static_cast<UInt8 *>(_out);
+        const UInt8 * base = static_cast<const UInt8 *>(_base);
+        Size i = 0;
+        while (i < _byteCount)
+        {
+            UInt64 zeros, literals;
+            if (!readVarint(zeros) || !readVarint(literals))
+                return false;
+            if ((!zeros && !literals) || zeros > _byteCount - i || literals > _byteCount - i - zeros ||
+                    literals > static_cast<Size>(m_end - m_pos))
+                return false;
+            for (Size end = i + zeros; i < end; ++i)
+                out[i] = baseByte(base, _baseByteCount, i);
+            for (Size end = i + literals; i < end; ++i)
+                out[i] = baseByte(base, _baseByteCount, i) ^ *m_pos++;
+        }
+        return true;
+    }
+
+    bool DeltaReader::skipXorRle(Size _byteCount)
+    {
+        Size i = 0;
+        while (i < _byteCount)
+        {
+            UInt64 zeros, literals;
+            if (!readVarint(zeros) || !readVarint(literals))
+                return false;
+            if ((!zeros && !literals) || zeros > _byteCount - i || literals > _byteCount - i - zeros ||
+                    !skipBytes(literals))
+                return false;
+            i += zeros + literals;
+        }
+        return true;
+    }
+
+    DeltaReader DeltaReader::consumedSince(const DeltaReader & _begin) const
+    {
+        return DeltaReader(_begin.m_pos, m_pos - _begin.m_pos);
+    }
+
+    bool DeltaReader::isAtEnd() const
+    {
+        return m_pos == m_end;
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef BRICK_DELTA_HPP
+#define BRICK_DELTA_HPP
+
+#include <Stick/DynamicArray.hpp>
+
+namespace brick
+{
+    // 64 bit FNV-1a of _byteCount bytes of _data, continuing from _hash.
+    STICK_API stick::UInt64 hashBytes(const void * _data, stick::Size _byteCount, stick::UInt64 _hash);
+
+    // Appends the primitives of the binary format of Hub::diff() to a byte array. Integers
+    // are written as LEB128 varints, so small ids and counts take a single byte. Multi byte
+    // values are written in the byte order of the machine.
+    class STICK_API DeltaWriter
+    {
+    public:
+
+        DeltaWriter(stick::DynamicArray<stick::UInt8> & _bytes);
+
+        void writeUInt8(stick::UInt8 _value);
+
+        void writeUInt64(stick::UInt64 _value);
+
+        void writeVarint(stick::UInt64 _value);
+
+        void writeBytes(const void * _data, stick::Size _byteCount);
+
+        // Writes _byteCount bytes of _data XORed with _base as alternating runs of zero bytes
+        // and literal bytes, so the bytes that equal _base cost next to nothing. _base holds
+        // _baseByteCount bytes, missing base bytes count as zero.
+        void writeXorRle(const void * _data, stick::Size _byteCount, const void * _base, stick::Size _baseByteCount);
+
+    private:
+
+        stick::DynamicArray<stick::UInt8> * m_bytes;
+    };
+
+    // Reads what DeltaWriter wrote. All functions return false if the data ends early or is
+    // malformed. Hub::applyDelta() checks a whole delta before it changes anything.
+    class STICK_API DeltaReader
+    {
+    public:
+
+        DeltaReader();
+
+        DeltaReader(const stick::UInt8 * _data, stick::Size _byteCount);
+
+        bool readUInt8(stick::UInt8 & _out);
+
+        bool readUInt64(stick::UInt64 & _out);
+
+        bool readVarint(stick::UInt64 & _out);
+
+        bool readBytes(void * _out, stick::Size _byteCount);
+
+        bool skipBytes(stick::Size _byteCount);
+
+        // Decodes what writeXorRle() wrote into _out. _out may point to _base to decode in place,
+        // but it may be left partially written if the data is malformed.
+        bool readXorRle(void * _out, stick::Size _byteCount, const void * _base, stick::Size _baseByteCount);
+
+        bool skipXorRle(stick::Size _byteCount);
+
+        // returns a reader for the bytes that were read since _begin was copied from this reader.
+        DeltaReader consumedSince(const DeltaReader & _begin) const;
+
+        bool isAtEnd() const;
+
+    private:
+
+        const stick::UInt8 * m_pos;
+        const stick::UInt8 * m_end;
+    };
+}
+
+#endif //BRICK_DELTA_HPP
@@ -74,4 +74,44 @@ namespace brick
         STICK_ASSERT(isValid() && _from.isValid());
         return m_hub->cloneComponents(_from.m_id, m_id);
     }
+
+    void Entity::setParent(const Entity & _parent)
+    {
+        STICK_ASSERT(isValid());
+        STICK_ASSERT(!_parent || _parent.m_hub == m_hub);
+        m_hub->setParent(m_id, _parent ? _parent.m_id : InvalidEntityID);
+    }
+
+    Entity Entity::parent() const
+    {
+        STICK_ASSERT(isValid());
+        auto node = maybe<Hierarchy>();
+        return node ? m_hub->entityForID((*node).parent) : Entity();
+    }
+
+    Entity Entity::firstChild() const
+    {
+        STICK_ASSERT(isValid());
+        auto node = maybe<Hierarchy>();
+        return node ? m_hub->entityForID((*node).firstChild) : Entity();
+    }
+
+    Entity Entity::nextSibling() const
+    {
+        STICK_ASSERT(isValid());
+        auto node = maybe<Hierarchy>();
+        return node ? m_hub->entityForID((*node).nextSibling) : Entity();
+    }
+
+    TypeID Entity::entityType() const
+    {
+        STICK_ASSERT(isValid());
+        return m_hub->m_entityTypes[m_id];
+    }
+
+    void Entity::setEntityType(TypeID _type)
+    {
+        STICK_ASSERT(isValid());
+        m_hub->m_entityTypes[m_id] = _type;
+    }
 }
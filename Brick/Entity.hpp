@@ -3,6 +3,7 @@
 
 #include <Brick/EntityID.hpp>
 #include <Stick/Maybe.hpp>
+#include <Stick/TypeInfo.hpp>
 
 #include <functional>
 
@@ -43,15 +44,26 @@ namespace brick
         bool hasComponent() const;
 
         template<class T, class...Args>
-        typename T::ValueType & ensureComponent(Args..._args);
+        typename T::ValueType & ensureComponent(Args && ..._args);
 
+        // Sets the component T, constructing it in place from _args if the entity
+        // does not have it yet and assigning otherwise.
         template<class T, class...Args>
-        void set(Args..._args);
+        void set(Args && ..._args);
 
+        // Like set() but returns the component.
         template<class T, class...Args>
-        void setAndApply(ApplyFunction _fn, Args..._args)
+        typename T::ValueType & emplace(Args && ..._args);
+
+        // Assigns _args to the existing component T, i.e. to move a new value in.
+        // The entity has to have the component already.
+        template<class T, class...Args>
+        typename T::ValueType & replace(Args && ..._args);
+
+        template<class T, class...Args>
+        void setAndApply(ApplyFunction _fn, Args && ..._args)
         {
-            set<T>(_args...);
+            set<T>(std::forward<Args>(_args)...);
             _fn(*this);
         }
 
@@ -102,6 +114,23 @@ namespace brick
 
         void assignEntity(const Entity & _e);
 
+        // Makes this entity a child of _parent, an invalid _parent makes it a root.
+        // Both entities get a Hierarchy component if they don't have one yet.
+        void setParent(const Entity & _parent);
+
+        Entity parent() const;
+
+        Entity firstChild() const;
+
+        Entity nextSibling() const;
+
+        // The TypeID of the typed entity class the entity was created as (see
+        // createEntity<T>() in TypedEntity.hpp) or 0. Stored in a dense array
+        // in the hub, so this does not need a component lookup.
+        stick::TypeID entityType() const;
+
+        void setEntityType(stick::TypeID _type);
+
         EntityID id() const
         {
             return m_id;
@@ -134,12 +163,29 @@ namespace brick
 namespace brick
 {
     template<class T, class ...Args>
-    void Entity::set(Args..._args)
+    void Entity::set(Args && ..._args)
     {
+        static_assert(!std::is_same<T, Hierarchy>::value, "use setParent() to change the hierarchy");
         STICK_ASSERT(isValid());
         m_hub->setComponent<T>(m_id, std::forward<Args>(_args)...);
     }
 
+    template<class T, class ...Args>
+    typename T::ValueType & Entity::emplace(Args && ..._args)
+    {
+        static_assert(!std::is_same<T, Hierarchy>::value, "use setParent() to change the hierarchy");
+        STICK_ASSERT(isValid());
+        return m_hub->setComponent<T>(m_id, std::forward<Args>(_args)...);
+    }
+
+    template<class T, class ...Args>
+    typename T::ValueType & Entity::replace(Args && ..._args)
+    {
+        static_assert(!std::is_same<T, Hierarchy>::value, "use setParent() to change the hierarchy");
+        STICK_ASSERT(isValid());
+        return m_hub->replaceComponent<T>(m_id, std::forward<Args>(_args)...);
+    }
+
     template<class T>
     void Entity::removeComponent()
     {
@@ -155,7 +201,7 @@ namespace brick
     }
 
     template<class T, class...Args>
-    typename T::ValueType & Entity::ensureComponent(Args..._args)
+    typename T::ValueType & Entity::ensureComponent(Args && ..._args)
     {
         if(!hasComponent<T>())
         {
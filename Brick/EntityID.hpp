@@ -6,6 +6,8 @@
 namespace brick
 {
     typedef stick::Size EntityID;
+
+    constexpr EntityID InvalidEntityID = static_cast<EntityID>(-1);
 }
 
 #endif //BRICK_ENTITYID_HPP
@@ -0,0 +1,25 @@
+#ifndef BRICK_HIERARCHY_HPP
+#define BRICK_HIERARCHY_HPP
+
+#include <Brick/Component.hpp>
+#include <Brick/EntityID.hpp>
+
+namespace brick
+{
+    // Node of the built-in entity hierarchy. Links are stored as plain entity ids
+    // to keep the node small, the hub keeps them up to date when entities get
+    // destroyed or compacted. Use Entity::setParent() to modify the hierarchy, the
+    // component can't be set directly and removing it detaches the entity from its
+    // parent and children.
+    struct HierarchyNode
+    {
+        EntityID parent;
+        EntityID firstChild;
+        EntityID nextSibling;
+        stick::Size depth;
+    };
+
+    using Hierarchy = Component<ComponentName("Hierarchy"), HierarchyNode>;
+}
+
+#endif //BRICK_HIERARCHY_HPP
@@ -5,50 +5,337 @@ namespace brick
 {
     using namespace stick;
 
-    stick::Size Hub::s_nextComponentID = 0;
+    namespace
+    {
+        // bumped whenever the binary format of Hub::diff() changes
+        constexpr UInt64 DeltaFormatVersion = 2;
+
+        // copies the elements of _from while _to keeps its allocator
+        template<class T>
+        void assignArray(DynamicArray<T> & _to, const DynamicArray<T> & _from)
+        {
+            _to.resize(_from.count());
+            for (Size i = 0; i < _from.count(); ++i)
+                _to[i] = _from[i];
+        }
+    }
+
+    std::mutex & Hub::componentRegistryMutex()
+    {
+        static std::mutex s_mutex;
+        return s_mutex;
+    }
+
+    DynamicArray<Hub::ComponentRecord> & Hub::componentRegistry()
+    {
+        static DynamicArray<ComponentRecord> s_registry;
+        return s_registry;
+    }
+
+    Size Hub::registerComponent(const ComponentRecord & _record)
+    {
+        std::lock_guard<std::mutex> lock(componentRegistryMutex());
+        DynamicArray<ComponentRecord> & registry = componentRegistry();
+        for (Size i = 0; i < registry.count(); ++i)
+        {
+            if (registry[i].hash == _record.hash)
+            {
+                if (registry[i].type == _record.type)
+                    return i;
+                //either the same name is used for two components or two names hash to the same value
+                STICK_ASSERT(!"component name hash collision");
+                break;
+            }
+        }
+        registry.append(_record);
+        STICK_ASSERT(registry.count() <= ComponentBitset().size());
+        return registry.count() - 1;
+    }
 
-    Hub::Hub(Allocator & _allocator) :
+    Size Hub::findComponent(UInt64 _hash, ComponentRecord & _outRecord)
+    {
+        std::lock_guard<std::mutex> lock(componentRegistryMutex());
+        const DynamicArray<ComponentRecord> & registry = componentRegistry();
+        for (Size i = 0; i < registry.count(); ++i)
+        {
+            if (registry[i].hash == _hash)
+            {
+                _outRecord = registry[i];
+                return i;
+            }
+        }
+        return ComponentStorage::InvalidIndex;
+    }
+
+    Hub::Hub(Allocator & _allocator, Size _arenaPageSize) :
         m_alloc(&_allocator),
-        m_componentStorage(_allocator),
-        m_componentBitsets(_allocator),
-        m_freeList(_allocator),
-        m_handleVersions(_allocator),
-        m_nextEntityID(0)
+        m_arena(_allocator.create<PagedArena>(_allocator, _arenaPageSize), _allocator),
+        m_componentStorage(*m_arena),
+        m_componentBitsets(*m_arena),
+        m_freeList(*m_arena),
+        m_sortedFreeList(_allocator),
+        m_bSortedFreeListValid(false),
+        m_handleVersions(*m_arena),
+        m_entityTypes(*m_arena),
+        m_nextEntityID(0),
+        m_versionBase(0),
+        m_maxVersion(0),
+        m_bHierarchyUsed(false),
+        m_bHierarchyDirty(false),
+        m_destroyQueue(_allocator),
+        m_componentBuffers(_allocator),
+        m_singletons(_allocator),
+        m_observers(_allocator),
+        m_spatialIndices(_allocator),
+        m_indices(_allocator),
+        m_bufferGeneration(0)
     {
 
     }
 
     Hub::~Hub()
     {
+        //storages need to go before the arena they live in
+        m_componentStorage.clear();
+    }
+
+    void Hub::clear()
+    {
+        BRICK_TRACE_SCOPE("Hub::clear");
+        //destroying the storages runs the destructors of non trivial components,
+        //everything else is simply forgotten when the arena gets rewound.
+        m_componentStorage = DynamicArray<UniquePtr<ComponentStorage>>(*m_arena);
+        m_componentBitsets = ComponentBitsetArray(*m_arena);
+        m_freeList = FreeList(*m_arena);
+        freeListChanged();
+        m_handleVersions = HandleVersionArray(*m_arena);
+        m_entityTypes = EntityTypeArray(*m_arena);
+        m_arena->reset();
+
+        m_nextEntityID = 0;
+        m_versionBase = m_maxVersion + 1;
+        m_maxVersion = m_versionBase;
+        m_bHierarchyUsed = false;
+        m_bHierarchyDirty = false;
+        for (auto & entry : m_observers)
+            entry.observer->componentsReset();
 
+        std::lock_guard<std::mutex> lock(m_destroyQueueMutex);
+        m_destroyQueue.clear();
     }
 
-    Entity Hub::createEntity()
+    void Hub::release()
     {
-        if (!m_freeList.count())
+        clear();
+        m_arena->release();
+    }
+
+    void Hub::compact(const RemapFunction & _fn)
+    {
+        BRICK_TRACE_SCOPE("Hub::compact");
+        DynamicArray<EntityID> remap(*m_alloc);
+        remap.resize(m_nextEntityID);
+        for (Size i = 0; i < m_nextEntityID; ++i)
+            remap[i] = i;
+        for (EntityID id : m_freeList)
+            remap[id] = InvalidEntityID;
+
+        EntityID next = 0;
+        bool bMoved = false;
+        for (Size i = 0; i < m_nextEntityID; ++i)
+        {
+            if (remap[i] != InvalidEntityID)
+            {
+                remap[i] = next++;
+                bMoved |= remap[i] != i;
+            }
+        }
+
+        //we need the old versions to pass the old handles to the remap function
+        DynamicArray<Size> oldVersions(*m_alloc);
+        if (_fn && bMoved)
+        {
+            oldVersions.reserve(m_handleVersions.count());
+            for (Size v : m_handleVersions)
+                oldVersions.append(v);
+        }
+
+        rebuild(remap, next);
+
+        if (_fn && bMoved)
+        {
+            for (Size i = 0; i < remap.count(); ++i)
+            {
+                if (remap[i] != InvalidEntityID && remap[i] != i)
+                    _fn(Entity(this, i, oldVersions[i]), Entity(this, remap[i], m_handleVersions[remap[i]]));
+            }
+        }
+    }
+
+    void Hub::shrinkToFit()
+    {
+        BRICK_TRACE_SCOPE("Hub::shrinkToFit");
+        Size count = m_nextEntityID;
+        std::sort(m_freeList.begin(), m_freeList.end());
+        while (m_freeList.count() && m_freeList.last() == count - 1)
+        {
+            m_freeList.removeLast();
+            --count;
+        }
+        //hand out the lowest free ids first to keep the id range dense
+        std::reverse(m_freeList.begin(), m_freeList.end());
+        freeListChanged();
+
+        DynamicArray<EntityID> remap(*m_alloc);
+        remap.resize(m_nextEntityID);
+        for (Size i = 0; i < m_nextEntityID; ++i)
+            remap[i] = i < count ? i : InvalidEntityID;
+
+        rebuild(remap, count);
+    }
+
+    void Hub::rebuild(const DynamicArray<EntityID> & _remap, Size _count)
+    {
+        UniquePtr<PagedArena> arena(m_alloc->create<PagedArena>(*m_alloc, m_arena->pageSize()), *m_alloc);
+        DynamicArray<UniquePtr<ComponentStorage>> storage(*arena);
+        ComponentBitsetArray bitsets(*arena);
+        HandleVersionArray versions(*arena);
+        EntityTypeArray types(*arena);
+        FreeList freeList(*arena);
+
+        //entities that change their id get a version no handle ever had
+        Size movedVersion = m_maxVersion + 1;
+        bool bMoved = false;
+        bitsets.resize(_count);
+        versions.resize(_count);
+        types.resize(_count);
+        for (Size i = 0; i < _remap.count(); ++i)
         {
-            Entity ret = createNextEntity();
-            for (auto & ptr : m_componentStorage)
+            EntityID to = _remap[i];
+            if (to == InvalidEntityID)
+                continue;
+            bitsets[to] = m_componentBitsets[i];
+            types[to] = m_entityTypes[i];
+            if (to == i)
+            {
+                versions[to] = m_handleVersions[i];
+            }
+            else
             {
-                if (ptr)
-                    ptr->resize(ret.m_id + 1);
+                versions[to] = movedVersion;
+                bMoved = true;
             }
-            return ret;
+        }
+
+        freeList.reserve(m_freeList.count());
+        for (EntityID id : m_freeList)
+        {
+            if (_remap[id] != InvalidEntityID)
+                freeList.append(_remap[id]);
+        }
+
+        //moving whole storages keeps their packed order intact
+        storage.resize(m_componentStorage.count());
+        for (Size c = 0; c < m_componentStorage.count(); ++c)
+        {
+            auto & old = m_componentStorage[c];
+            if (!old)
+                continue;
+            storage[c] = old->createEmpty(*arena);
+            storage[c]->resize(_count);
+            storage[c]->reserve(old->count());
+            old->moveAll(*storage[c], _remap);
+        }
+
+        //the hierarchy links are entity ids and need to follow the remapping
+        if (m_bHierarchyUsed)
+        {
+            auto remapID = [&](EntityID _id)
+            {
+                return _id == InvalidEntityID ? _id : _remap[_id];
+            };
+            ComponentStorage * hs = componentID<Hierarchy>() < storage.count() ? storage[componentID<Hierarchy>()].get() : nullptr;
+            if (hs)
+            {
+                auto & nodes = storageFor<HierarchyNode>(*hs);
+                for (Size i = 0; i < nodes.count(); ++i)
+                {
+                    HierarchyNode & node = nodes.at(i);
+                    node.parent = remapID(node.parent);
+                    node.firstChild = remapID(node.firstChild);
+                    node.nextSibling = remapID(node.nextSibling);
+                }
+            }
+        }
+
+        //the old storages have to be destroyed before their arena
+        m_componentStorage = std::move(storage);
+        m_componentBitsets = std::move(bitsets);
+        m_handleVersions = std::move(versions);
+        m_entityTypes = std::move(types);
+        m_freeList = std::move(freeList);
+        freeListChanged();
+        UniquePtr<PagedArena> oldArena = std::move(m_arena);
+        m_arena = std::move(arena);
+
+        m_nextEntityID = _count;
+        if (bMoved)
+            m_maxVersion = movedVersion;
+        //dropped ids might come back later, make sure their stale handles stay invalid
+        m_versionBase = m_maxVersion + 1;
+
+        //the observers see the storages under the new entity ids
+        for (Size c = 0; c < m_componentStorage.count(); ++c)
+        {
+            if (!m_componentStorage[c])
+                continue;
+            attachObservers(c);
+            m_componentStorage[c]->notifyReset();
+        }
+    }
+
+    Entity Hub::createEntity()
+    {
+        BRICK_TRACE_SCOPE("Hub::createEntity");
+        BRICK_COUNT(this, createdEntities, 1);
+        if (!m_freeList.count())
+        {
+            //storages grow lazily once a component gets set
+            return createNextEntity();
         }
         else
         {
             EntityID id = m_freeList.last();
             m_freeList.removeLast();
+            freeListChanged();
             return Entity(this, id, m_handleVersions[id]);
         }
     }
 
+    const Hub::FreeList & Hub::sortedFreeList() const
+    {
+        if (!m_bSortedFreeListValid.load(std::memory_order_acquire))
+        {
+            std::lock_guard<std::mutex> lock(m_sortedFreeListMutex);
+            if (!m_bSortedFreeListValid.load(std::memory_order_relaxed))
+            {
+                m_sortedFreeList.resize(m_freeList.count());
+                for (Size i = 0; i < m_freeList.count(); ++i)
+                    m_sortedFreeList[i] = m_freeList[i];
+                std::sort(m_sortedFreeList.begin(), m_sortedFreeList.end());
+                m_bSortedFreeListValid.store(true, std::memory_order_release);
+            }
+        }
+        return m_sortedFreeList;
+    }
+
     Entity Hub::createNextEntity()
     {
         EntityID id = m_nextEntityID++;
         m_componentBitsets.append(ComponentBitset(0));
-        m_handleVersions.append(0);
-        return Entity(this, id, 0);
+        m_handleVersions.append(m_versionBase);
+        m_entityTypes.append(0);
+        return Entity(this, id, m_versionBase);
     }
 
     bool Hub::isValid(EntityID _id, Size _version) const
@@ -58,15 +345,771 @@ namespace brick
 
     void Hub::destroyEntity(const Entity & _entity)
     {
+        BRICK_TRACE_SCOPE("Hub::destroyEntity");
+        BRICK_COUNT(this, destroyedEntities, 1);
         m_freeList.append(_entity.m_id);
+        freeListChanged();
+        if (m_bHierarchyUsed && m_componentBitsets[_entity.m_id][componentID<Hierarchy>()])
+            detachHierarchy(_entity.m_id);
         //reset all the components of this entity
-        for (auto & ptr : m_componentStorage)
+        const ComponentBitset & bits = m_componentBitsets[_entity.m_id];
+        for (Size i = 0; i < m_componentStorage.count(); ++i)
         {
-            if (ptr)
+            auto & ptr = m_componentStorage[i];
+            if (ptr && bits[i])
                 ptr->resetComponent(_entity.m_id);
         }
         m_componentBitsets[_entity.m_id].reset();
-        m_handleVersions[_entity.m_id]++;
+        m_entityTypes[_entity.m_id] = 0;
+        Size version = ++m_handleVersions[_entity.m_id];
+        if (version > m_maxVersion)
+            m_maxVersion = version;
+    }
+
+    Entity Hub::migrate(const Entity & _entity, Hub & _target)
+    {
+        STICK_ASSERT(_entity.m_hub == this && _entity.isValid());
+        DynamicArray<EntityID> ids(*m_alloc);
+        ids.append(_entity.m_id);
+        DynamicArray<EntityID> targetIDs(*m_alloc);
+        migrateEntities(ids, _target, targetIDs);
+        return _target.entityForID(targetIDs[0]);
+    }
+
+    void Hub::migrateEntities(const DynamicArray<EntityID> & _ids, Hub & _target, DynamicArray<EntityID> & _targetIDs)
+    {
+        BRICK_TRACE_SCOPE("Hub::migrate");
+        STICK_ASSERT(&_target != this);
+
+        Size hid = componentID<Hierarchy>();
+        _targetIDs.reserve(_targetIDs.count() + _ids.count());
+        for (EntityID id : _ids)
+        {
+            if (m_bHierarchyUsed && m_componentBitsets[id][hid])
+                removeComponent<Hierarchy>(id);
+            EntityID tid = _target.createEntity().m_id;
+            _target.m_componentBitsets[tid] = m_componentBitsets[id];
+            _target.m_entityTypes[tid] = m_entityTypes[id];
+            _targetIDs.append(tid);
+        }
+
+        //column wise, every storage is walked once for the whole batch
+        for (Size c = 0; c < m_componentStorage.count(); ++c)
+        {
+            ComponentStorage * s = m_componentStorage[c].get();
+            if (!s || !s->count())
+                continue;
+
+            if (_target.m_componentStorage.count() <= c)
+                _target.m_componentStorage.resize(c + 1);
+            auto & ts = _target.m_componentStorage[c];
+            if (!ts)
+            {
+                ts = s->createEmpty(*_target.m_arena);
+                ts->resize(_target.m_nextEntityID);
+                _target.attachObservers(c);
+            }
+            s->migrate(*ts, _ids, _targetIDs);
+        }
+
+        //the components are gone already, only the bookkeeping is left
+        for (EntityID id : _ids)
+        {
+            m_componentBitsets[id].reset();
+            m_entityTypes[id] = 0;
+            m_freeList.append(id);
+            Size version = ++m_handleVersions[id];
+            if (version > m_maxVersion)
+                m_maxVersion = version;
+        }
+        freeListChanged();
+        BRICK_COUNT(this, destroyedEntities, _ids.count());
+    }
+
+    Size Hub::splice(Hub & _staging, const RemapFunction & _fn)
+    {
+        BRICK_TRACE_SCOPE("Hub::splice");
+        STICK_ASSERT(&_staging != this);
+
+        EntityID base = m_nextEntityID;
+        Size n = _staging.m_nextEntityID;
+        DynamicArray<EntityID> remap(*m_alloc);
+        remap.resize(n);
+        for (Size i = 0; i < n; ++i)
+            remap[i] = base + i;
+
+        m_componentBitsets.reserve(base + n);
+        m_handleVersions.reserve(base + n);
+        m_entityTypes.reserve(base + n);
+        for (Size i = 0; i < n; ++i)
+        {
+            m_componentBitsets.append(_staging.m_componentBitsets[i]);
+            m_handleVersions.append(m_versionBase);
+            m_entityTypes.append(_staging.m_entityTypes[i]);
+        }
+        for (EntityID id : _staging.m_freeList)
+        {
+            m_freeList.append(base + id);
+            //free ids don't have components, this only keeps them away from _fn
+            remap[id] = InvalidEntityID;
+        }
+        freeListChanged();
+        m_nextEntityID += n;
+
+        for (Size c = 0; c < _staging.m_componentStorage.count(); ++c)
+        {
+            ComponentStorage * s = _staging.m_componentStorage[c].get();
+            if (!s || !s->count())
+                continue;
+
+            if (m_componentStorage.count() <= c)
+                m_componentStorage.resize(c + 1);
+            auto & ts = m_componentStorage[c];
+            if (!ts)
+            {
+                ts = s->createEmpty(*m_arena);
+                attachObservers(c);
+            }
+            ts->resize(m_nextEntityID);
+            ts->reserve(ts->count() + s->count());
+            s->moveAll(*ts, remap);
+        }
+
+        //hierarchy links of the staged entities only point at other staged entities
+        ComponentStorage * hs = storage(componentID<Hierarchy>());
+        if (_staging.m_bHierarchyUsed && hs)
+        {
+            auto & nodes = storageFor<HierarchyNode>(*hs);
+            for (Size i = 0; i < nodes.count(); ++i)
+            {
+                if (nodes.m_entities[i] < base)
+                    continue;
+                HierarchyNode & node = nodes.at(i);
+                if (node.parent != InvalidEntityID)
+                    node.parent += base;
+                if (node.firstChild != InvalidEntityID)
+                    node.firstChild += base;
+                if (node.nextSibling != InvalidEntityID)
+                    node.nextSibling += base;
+            }
+            m_bHierarchyUsed = true;
+            m_bHierarchyDirty = true;
+        }
+
+        Size ret = _staging.entityCount();
+        if (_fn)
+        {
+            for (Size i = 0; i < n; ++i)
+            {
+                if (remap[i] != InvalidEntityID)
+                    _fn(Entity(&_staging, i, _staging.m_handleVersions[i]), Entity(this, remap[i], m_versionBase));
+            }
+        }
+        _staging.clear();
+        return ret;
+    }
+
+    Hub::Snapshot Hub::snapshot()
+    {
+        BRICK_TRACE_SCOPE("Hub::snapshot");
+        Snapshot ret(*m_alloc);
+        ret.m_columns.resize(m_componentStorage.count());
+        for (Size i = 0; i < m_componentStorage.count(); ++i)
+        {
+            if (m_componentStorage[i] && m_componentStorage[i]->isClonable())
+                ret.m_columns[i] = m_componentStorage[i]->snapshot(*m_alloc);
+        }
+        assignArray(ret.m_componentBitsets, m_componentBitsets);
+        for (Size i = 0; i < m_componentStorage.count(); ++i)
+        {
+            //the components that are not captured are not in the snapshot's bitsets either
+            if (m_componentStorage[i] && !m_componentStorage[i]->isClonable())
+            {
+                for (ComponentBitset & bits : ret.m_componentBitsets)
+                    bits[i] = false;
+            }
+        }
+        assignArray(ret.m_handleVersions, m_handleVersions);
+        assignArray(ret.m_entityTypes, m_entityTypes);
+        assignArray(ret.m_freeList, m_freeList);
+        ret.m_nextEntityID = m_nextEntityID;
+        ret.m_maxVersion = m_maxVersion;
+        ret.m_bHierarchyUsed = m_bHierarchyUsed;
+        return ret;
+    }
+
+    void Hub::restore(const Snapshot & _snapshot)
+    {
+        BRICK_TRACE_SCOPE("Hub::restore");
+        if (m_componentStorage.count() < _snapshot.m_columns.count())
+            m_componentStorage.resize(_snapshot.m_columns.count());
+
+        //components that can't be cloned were not captured, they are only kept by the entities
+        //that are the same in the hub and the snapshot
+        DynamicArray<Size> uncaptured(*m_alloc);
+        for (Size i = 0; i < m_componentStorage.count(); ++i)
+        {
+            if (m_componentStorage[i] && !m_componentStorage[i]->isClonable())
+                uncaptured.append(i);
+        }
+        if (uncaptured.count())
+        {
+            DynamicArray<UInt8> alive(*m_alloc);
+            alive.resize(_snapshot.m_nextEntityID);
+            for (Size id = 0; id < _snapshot.m_nextEntityID; ++id)
+                alive[id] = 1;
+            for (EntityID id : _snapshot.m_freeList)
+                alive[id] = 0;
+            for (Size c : uncaptured)
+            {
+                ComponentStorage & s = *m_componentStorage[c];
+                //back to front, removing moves the last component into the hole
+                for (Size i = s.count(); i > 0; --i)
+                {
+                    EntityID id = s.m_entities[i - 1];
+                    if (id >= _snapshot.m_nextEntityID || !alive[id] || m_handleVersions[id] != _snapshot.m_handleVersions[id])
+                        s.resetComponent(id);
+                }
+            }
+        }
+
+        for (Size i = 0; i < m_componentStorage.count(); ++i)
+        {
+            const SnapshotColumn * column = i < _snapshot.m_columns.count() ? _snapshot.m_columns[i].get() : nullptr;
+            auto & storage = m_componentStorage[i];
+            if (!storage)
+            {
+                if (!column)
+                    continue;
+                storage = column->createStorage(*m_arena);
+                attachObservers(i);
+            }
+            if (!storage->isClonable())
+            {
+                storage->resize(_snapshot.m_nextEntityID);
+                continue;
+            }
+            storage->restore(column);
+            storage->resize(_snapshot.m_nextEntityID);
+            storage->notifyReset();
+        }
+
+        assignArray(m_componentBitsets, _snapshot.m_componentBitsets);
+        for (Size c : uncaptured)
+        {
+            const ComponentStorage & s = *m_componentStorage[c];
+            for (Size i = 0; i < s.count(); ++i)
+                m_componentBitsets[s.m_entities[i]][c] = true;
+        }
+        assignArray(m_handleVersions, _snapshot.m_handleVersions);
+        assignArray(m_entityTypes, _snapshot.m_entityTypes);
+        assignArray(m_freeList, _snapshot.m_freeList);
+        freeListChanged();
+        m_nextEntityID = _snapshot.m_nextEntityID;
+        //versions never go back, so compact() can still hand out versions no handle ever had
+        m_maxVersion = std::max(m_maxVersion, _snapshot.m_maxVersion);
+        //the breadth first order is not tracked by the snapshot
+        m_bHierarchyUsed = m_bHierarchyUsed || _snapshot.m_bHierarchyUsed;
+        m_bHierarchyDirty = m_bHierarchyUsed;
+    }
+
+    DynamicArray<UInt8> Hub::diff(const Snapshot & _baseline, const Snapshot & _current, bool _bXorRle, Allocator & _alloc)
+    {
+        BRICK_TRACE_SCOPE("Hub::diff");
+        DynamicArray<UInt8> ret(_alloc);
+        DeltaWriter out(ret);
+        out.writeVarint(DeltaFormatVersion);
+        out.writeVarint(_baseline.m_nextEntityID);
+        out.writeVarint(_baseline.entityCount());
+        out.writeVarint(_current.m_nextEntityID);
+
+        //entities whose handle version changed, the ids are written as the gap to the previous one
+        auto isChanged = [&](Size _id)
+        {
+            return _id >= _baseline.m_nextEntityID || _baseline.m_handleVersions[_id] != _current.m_handleVersions[_id];
+        };
+        Size changed = 0;
+        for (Size i = 0; i < _current.m_nextEntityID; ++i)
+            changed += isChanged(i);
+        out.writeVarint(changed);
+        Size next = 0;
+        for (Size i = 0; i < _current.m_nextEntityID; ++i)
+        {
+            if (!isChanged(i))
+                continue;
+            out.writeVarint(i - next);
+            out.writeVarint(_current.m_handleVersions[i]);
+            next = i + 1;
+        }
+
+        bool bFreeListChanged = _baseline.m_freeList.count() != _current.m_freeList.count();
+        for (Size i = 0; !bFreeListChanged && i < _current.m_freeList.count(); ++i)
+            bFreeListChanged = _baseline.m_freeList[i] != _current.m_freeList[i];
+        out.writeUInt8(bFreeListChanged);
+        if (bFreeListChanged)
+        {
+            out.writeVarint(_current.m_freeList.count());
+            for (EntityID id : _current.m_freeList)
+                out.writeVarint(id);
+        }
+
+        Size columnCount = std::max(_baseline.m_columns.count(), _current.m_columns.count());
+        for (Size i = 0; i < columnCount; ++i)
+        {
+            const SnapshotColumn * baseline = i < _baseline.m_columns.count() ? _baseline.m_columns[i].get() : nullptr;
+            const SnapshotColumn * current = i < _current.m_columns.count() ? _current.m_columns[i].get() : nullptr;
+            const SnapshotColumn * column = current ? current : baseline;
+            if (!column || !column->isTriviallyCopyable())
+                continue;
+            UInt64 hash;
+            {
+                std::lock_guard<std::mutex> lock(componentRegistryMutex());
+                hash = componentRegistry()[i].hash;
+            }
+            column->writeDelta(baseline, current, hash, _bXorRle, out);
+        }
+
+        //tags only live in the bitsets, so the entities whose bit changed are written per tag
+        //as the gap to the previous one with the new bit in the lowest bit
+        DynamicArray<Size> tagIDs(_alloc);
+        DynamicArray<UInt64> tagHashes(_alloc);
+        {
+            std::lock_guard<std::mutex> lock(componentRegistryMutex());
+            const DynamicArray<ComponentRecord> & registry = componentRegistry();
+            for (Size i = 0; i < registry.count(); ++i)
+            {
+                if (!registry[i].factory)
+                {
+                    tagIDs.append(i);
+                    tagHashes.append(registry[i].hash);
+                }
+            }
+        }
+        for (Size t = 0; t < tagIDs.count(); ++t)
+        {
+            Size cid = tagIDs[t];
+            auto isTagChanged = [&](Size _id)
+            {
+                bool bBaseline = _id < _baseline.m_nextEntityID && _baseline.m_componentBitsets[_id][cid];
+                return _current.m_componentBitsets[_id][cid] != bBaseline;
+            };
+            Size tagChanged = 0;
+            for (Size i = 0; i < _current.m_nextEntityID; ++i)
+                tagChanged += isTagChanged(i);
+            if (!tagChanged)
+                continue;
+            out.writeUInt8(2);
+            out.writeUInt64(tagHashes[t]);
+            out.writeVarint(tagChanged);
+            next = 0;
+            for (Size i = 0; i < _current.m_nextEntityID; ++i)
+            {
+                if (!isTagChanged(i))
+                    continue;
+                out.writeVarint(((i - next) << 1) | _current.m_componentBitsets[i][cid]);
+                next = i + 1;
+            }
+        }
+        out.writeUInt8(0);
+        return ret;
+    }
+
+    bool Hub::applyDelta(const UInt8 * _data, Size _byteCount)
+    {
+        BRICK_TRACE_SCOPE("Hub::applyDelta");
+        struct DeltaColumn
+        {
+            Size componentID;
+            Size count;
+            Size firstPage;
+            Size pageCount;
+            StorageFactory factory;
+        };
+
+        struct DeltaTag
+        {
+            Size componentID;
+            Size count;
+            DeltaReader entities;
+        };
+
+        //check the whole delta before anything is changed
+        DeltaReader in(_data, _byteCount);
+        UInt64 format, baseNext, baseCount, next, changed;
+        if (!in.readVarint(format) || format != DeltaFormatVersion ||
+                !in.readVarint(baseNext) || !in.readVarint(baseCount) ||
+                !in.readVarint(next) || !in.readVarint(changed))
+            return false;
+        if (baseNext != m_nextEntityID || baseCount != entityCount() || changed > next)
+            return false;
+
+        DeltaReader entities = in;
+        UInt64 id = 0;
+        for (Size i = 0; i < changed; ++i)
+        {
+            UInt64 gap, version;
+            if (!in.readVarint(gap) || !in.readVarint(version) || gap >= next - id)
+                return false;
+            id += gap + 1;
+        }
+
+        UInt8 bFreeListChanged;
+        if (!in.readUInt8(bFreeListChanged) || bFreeListChanged > 1)
+            return false;
+        DeltaReader freeList = in;
+        if (bFreeListChanged)
+        {
+            UInt64 freeCount;
+            if (!in.readVarint(freeCount) || freeCount > next)
+                return false;
+            for (Size i = 0; i < freeCount; ++i)
+            {
+                UInt64 freeID;
+                if (!in.readVarint(freeID) || freeID >= next)
+                    return false;
+            }
+        }
+
+        DynamicArray<DeltaColumn> columns(*m_alloc);
+        DynamicArray<DeltaPage> pages(*m_alloc);
+        DynamicArray<DeltaTag> tags(*m_alloc);
+        while (true)
+        {
+            UInt8 marker;
+            if (!in.readUInt8(marker) || marker > 2)
+                return false;
+            if (!marker)
+                break;
+
+            if (marker == 2)
+            {
+                UInt64 hash, tagChanged;
+                if (!in.readUInt64(hash) || !in.readVarint(tagChanged) || tagChanged > next)
+                    return false;
+                DeltaReader tagEntities = in;
+                UInt64 tagID = 0;
+                for (Size i = 0; i < tagChanged; ++i)
+                {
+                    UInt64 entry;
+                    if (!in.readVarint(entry) || (entry >> 1) >= next - tagID)
+                        return false;
+                    tagID += (entry >> 1) + 1;
+                }
+                ComponentRecord record = {};
+                Size cid = findComponent(hash, record);
+                //a component that has a storage here can't be a tag on the other side
+                if (cid != ComponentStorage::InvalidIndex && record.factory)
+                    return false;
+                tags.append({cid, tagChanged, tagEntities});
+                continue;
+            }
+
+            UInt64 hash, valueSize, pageSize, count, pageCount;
+            if (!in.readUInt64(hash) || !in.readVarint(valueSize) || !in.readVarint(pageSize) ||
+                    !in.readVarint(count) || !in.readVarint(pageCount))
+                return false;
+            if (pageSize != ComponentStorageBaseT<UInt8>::PageSize || count > next || pageCount > (count + pageSize - 1) / pageSize)
+                return false;
+
+            //components that were never used in this process are skipped. The storages that
+            //don't exist yet are only created once the whole delta is known to be valid.
+            ComponentRecord record = {};
+            Size cid = findComponent(hash, record);
+            const ComponentStorage * storage = nullptr;
+            if (cid != ComponentStorage::InvalidIndex)
+            {
+                if (!record.factory || !record.bTriviallyCopyable || record.valueSize != valueSize)
+                    return false;
+                storage = cid < m_componentStorage.count() ? m_componentStorage[cid].get() : nullptr;
+            }
+
+            columns.append({cid, count, pages.count(), pageCount, record.factory});
+            for (Size i = 0; i < pageCount; ++i)
+            {
+                DeltaPage page;
+                UInt64 index, baselineHash;
+                UInt8 bXorRle;
+                if (!in.readVarint(index) || !in.readUInt64(baselineHash) || !in.readUInt8(bXorRle) || bXorRle > 1 ||
+                        index >= (count + pageSize - 1) / pageSize || (i && index <= pages.last().index))
+                    return false;
+                //refuse deltas that were not made against the current state of the page
+                if (cid != ComponentStorage::InvalidIndex && baselineHash !=
+                        (storage ? storage->pageHash(index) : ComponentStorageBaseT<UInt8>::pageHash(nullptr, nullptr, 0)))
+                    return false;
+                page.index = index;
+                page.bXorRle = bXorRle;
+                Size c = std::min(pageSize, count - index * pageSize);
+                DeltaReader begin = in;
+                if (cid != ComponentStorage::InvalidIndex)
+                {
+                    //the entity ids are decoded and range checked here, the storage trusts them
+                    EntityID ids[ComponentStorageBaseT<UInt8>::PageSize];
+                    Size first = index * pageSize;
+                    Size oldC = storage && first < storage->count() ? std::min((Size)pageSize, storage->count() - first) : 0;
+                    const EntityID * base = oldC ? &storage->m_entities[first] : nullptr;
+                    if (!(bXorRle ? in.readXorRle(ids, sizeof(EntityID) * c, base, sizeof(EntityID) * oldC) :
+                            in.readBytes(ids, sizeof(EntityID) * c)))
+                        return false;
+                    for (Size j = 0; j < c; ++j)
+                    {
+                        if (ids[j] >= next)
+                            return false;
+                    }
+                }
+                else if (!(bXorRle ? in.skipXorRle(sizeof(EntityID) * c) : in.skipBytes(sizeof(EntityID) * c)))
+                {
+                    return false;
+                }
+                page.entities = in.consumedSince(begin);
+                begin = in;
+                if (!(bXorRle ? in.skipXorRle(valueSize * c) : in.skipBytes(valueSize * c)))
+                    return false;
+                page.values = in.consumedSince(begin);
+                pages.append(page);
+            }
+        }
+        if (!in.isAtEnd())
+            return false;
+
+        for (const DeltaColumn & column : columns)
+        {
+            Size cid = column.componentID;
+            if (cid == ComponentStorage::InvalidIndex)
+                continue;
+            if (m_componentStorage.count() <= cid)
+                m_componentStorage.resize(cid + 1);
+            if (!m_componentStorage[cid])
+            {
+                m_componentStorage[cid] = column.factory(*m_arena);
+                m_componentStorage[cid]->resize(m_nextEntityID);
+                attachObservers(cid);
+            }
+        }
+
+        Size oldNext = m_nextEntityID;
+        Size maxNext = std::max(oldNext, (Size)next);
+        for (Size i = oldNext; i < maxNext; ++i)
+        {
+            m_componentBitsets.append(ComponentBitset(0));
+            m_handleVersions.append(m_versionBase);
+            m_entityTypes.append(0);
+        }
+        for (auto & storage : m_componentStorage)
+        {
+            if (storage)
+                storage->resize(maxNext);
+        }
+
+        //The delta only covers trivially copyable components, the others are removed from
+        //destroyed entities. The hierarchy links arrive with the Hierarchy pages.
+        auto resetUncovered = [&](EntityID _id)
+        {
+            for (Size c = 0; c < m_componentStorage.count(); ++c)
+            {
+                auto & storage = m_componentStorage[c];
+                if (storage && !storage->isTriviallyCopyable() && m_componentBitsets[_id][c])
+                {
+                    storage->resetComponent(_id);
+                    m_componentBitsets[_id][c] = false;
+                }
+            }
+            m_entityTypes[_id] = 0;
+        };
+        id = 0;
+        for (Size i = 0; i < changed; ++i)
+        {
+            UInt64 gap, version;
+            entities.readVarint(gap);
+            entities.readVarint(version);
+            id += gap;
+            if (id < oldNext)
+                resetUncovered(id);
+            m_handleVersions[id] = version;
+            if (version > m_maxVersion)
+                m_maxVersion = version;
+            ++id;
+        }
+        for (Size i = next; i < oldNext; ++i)
+            resetUncovered(i);
+
+        for (const DeltaColumn & column : columns)
+        {
+            if (column.componentID == ComponentStorage::InvalidIndex)
+                continue;
+            ComponentStorage & s = *m_componentStorage[column.componentID];
+            s.applyDelta(&pages[column.firstPage], column.pageCount, column.count, m_componentBitsets, column.componentID);
+            s.notifyReset();
+        }
+
+        for (const DeltaTag & tag : tags)
+        {
+            if (tag.componentID == ComponentStorage::InvalidIndex)
+                continue;
+            DeltaReader reader = tag.entities;
+            id = 0;
+            for (Size i = 0; i < tag.count; ++i)
+            {
+                UInt64 entry;
+                reader.readVarint(entry);
+                id += entry >> 1;
+                m_componentBitsets[id][tag.componentID] = entry & 1;
+                ++id;
+            }
+        }
+
+        if (bFreeListChanged)
+        {
+            UInt64 freeCount;
+            freeList.readVarint(freeCount);
+            m_freeList.resize(freeCount);
+            for (Size i = 0; i < freeCount; ++i)
+            {
+                UInt64 freeID;
+                freeList.readVarint(freeID);
+                m_freeList[i] = freeID;
+            }
+            freeListChanged();
+        }
+
+        m_nextEntityID = next;
+        m_componentBitsets.resize(next);
+        m_handleVersions.resize(next);
+        m_entityTypes.resize(next);
+
+        ComponentStorage * hierarchy = storage(componentID<Hierarchy>());
+        if (hierarchy && hierarchy->count())
+        {
+            m_bHierarchyUsed = true;
+            m_bHierarchyDirty = true;
+        }
+        return true;
+    }
+
+    void Hub::addObserver(Size _componentID, UniquePtr<ComponentObserver> _observer)
+    {
+        ComponentObserver * observer = _observer.get();
+        ObserverEntry entry = {_componentID, std::move(_observer)};
+        m_observers.append(std::move(entry));
+        ComponentStorage * s = storage(_componentID);
+        if (s)
+        {
+            s->m_observers.append(observer);
+            s->reportAll(*observer);
+        }
+    }
+
+    void Hub::attachObservers(Size _componentID)
+    {
+        ComponentStorage * s = storage(_componentID);
+        if (!s)
+            return;
+        s->m_observers.clear();
+        for (auto & entry : m_observers)
+        {
+            if (entry.componentID == _componentID)
+                s->m_observers.append(entry.observer.get());
+        }
+    }
+
+    Hub::Snapshot::Snapshot(Allocator & _alloc) :
+        m_columns(_alloc),
+        m_componentBitsets(_alloc),
+        m_handleVersions(_alloc),
+        m_entityTypes(_alloc),
+        m_freeList(_alloc),
+        m_nextEntityID(0),
+        m_maxVersion(0),
+        m_bHierarchyUsed(false)
+    {
+    }
+
+    Size Hub::Snapshot::entityCount() const
+    {
+        return m_nextEntityID - m_freeList.count();
+    }
+
+    void Hub::queueDestroy(const Entity & _entity)
+    {
+        STICK_ASSERT(_entity.m_hub == this);
+        std::lock_guard<std::mutex> lock(m_destroyQueueMutex);
+        m_destroyQueue.append({_entity.m_id, _entity.m_version});
+    }
+
+    Size Hub::collectGarbage()
+    {
+        BRICK_TRACE_SCOPE("Hub::collectGarbage");
+        Size ret = 0;
+        DestroyQueue batch(*m_alloc);
+        while (true)
+        {
+            {
+                //swap the queue out so that destructors can queue more entities without deadlocking
+                std::lock_guard<std::mutex> lock(m_destroyQueueMutex);
+                if (!m_destroyQueue.count())
+                    break;
+                std::swap(batch, m_destroyQueue);
+            }
+            ret += destroyEntities(batch);
+            batch.clear();
+        }
+        return ret;
+    }
+
+    Size Hub::queuedDestroyCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_destroyQueueMutex);
+        return m_destroyQueue.count();
+    }
+
+    Size Hub::destroyEntities(const DestroyQueue & _entities)
+    {
+        DynamicArray<EntityID> ids(*m_alloc);
+        ids.reserve(_entities.count());
+        for (const QueuedDestroy & e : _entities)
+        {
+            //skip entities that are gone already or were queued more than once
+            if (!isValid(e.id, e.version))
+                continue;
+            //invalidate right away so that components releasing handles to
+            //entities of this batch don't try to destroy them again
+            Size version = ++m_handleVersions[e.id];
+            if (version > m_maxVersion)
+                m_maxVersion = version;
+            ids.append(e.id);
+        }
+
+        if (m_bHierarchyUsed)
+        {
+            Size hid = componentID<Hierarchy>();
+            for (EntityID id : ids)
+            {
+                if (m_componentBitsets[id][hid])
+                    detachHierarchy(id);
+            }
+        }
+
+        //one pass per storage rather than one pass over all storages per entity
+        for (Size i = 0; i < m_componentStorage.count(); ++i)
+        {
+            auto & ptr = m_componentStorage[i];
+            if (!ptr)
+                continue;
+            for (EntityID id : ids)
+            {
+                if (m_componentBitsets[id][i])
+                    ptr->resetComponent(id);
+            }
+        }
+
+        for (EntityID id : ids)
+        {
+            m_componentBitsets[id].reset();
+            m_entityTypes[id] = 0;
+            m_freeList.append(id);
+        }
+        freeListChanged();
+        BRICK_COUNT(this, destroyedEntities, ids.count());
+        return ids.count();
     }
 
     Size Hub::entityCount() const
@@ -74,6 +1117,216 @@ namespace brick
         return m_nextEntityID - m_freeList.count();
     }
 
+    HubStats Hub::stats() const
+    {
+        HubStats ret(*m_alloc);
+        ret.entityCount = entityCount();
+        ret.freeListCount = m_freeList.count();
+        ret.entityHighWaterMark = m_nextEntityID;
+        ret.bitsetBytes = m_componentBitsets.capacity() * sizeof(ComponentBitset);
+        ret.entityBytes = m_handleVersions.capacity() * sizeof(Size) +
+                          m_entityTypes.capacity() * sizeof(TypeID) +
+                          m_freeList.capacity() * sizeof(EntityID);
+        {
+            std::lock_guard<std::mutex> lock(m_sortedFreeListMutex);
+            ret.entityBytes += m_sortedFreeList.capacity() * sizeof(EntityID);
+        }
+        ret.arenaReservedBytes = m_arena->reservedByteCount();
+
+        {
+            std::lock_guard<std::mutex> lock(componentRegistryMutex());
+            const DynamicArray<ComponentRecord> & registry = componentRegistry();
+            for (Size i = 0; i < m_componentStorage.count(); ++i)
+            {
+                const ComponentStorage * s = m_componentStorage[i].get();
+                if (!s)
+                    continue;
+                ComponentStats cs;
+                cs.name = registry[i].name;
+                cs.hash = registry[i].hash;
+                cs.componentID = i;
+                cs.count = s->count();
+                cs.capacity = s->capacity();
+                cs.sparseCount = s->m_sparse.count();
+                cs.valueSize = s->valueSize();
+                cs.bytesUsed = cs.count * (cs.valueSize + sizeof(EntityID) + sizeof(Size));
+                cs.bytesWasted = (cs.capacity - cs.count) * cs.valueSize +
+                                 (s->m_entities.capacity() - cs.count) * sizeof(EntityID) +
+                                 (s->m_sparse.capacity() - cs.count) * sizeof(Size);
+                ret.components.append(cs);
+            }
+        }
+
+        //all zero unless Brick is built with BRICK_ENABLE_COUNTERS
+        ret.counters.createdEntities = m_counters.createdEntities.load(std::memory_order_relaxed);
+        ret.counters.destroyedEntities = m_counters.destroyedEntities.load(std::memory_order_relaxed);
+        ret.counters.setComponents = m_counters.setComponents.load(std::memory_order_relaxed);
+        ret.counters.removedComponents = m_counters.removedComponents.load(std::memory_order_relaxed);
+        ret.counters.viewIterations = m_counters.viewIterations.load(std::memory_order_relaxed);
+        return ret;
+    }
+
+    void Hub::resetCounters()
+    {
+        m_counters.createdEntities = 0;
+        m_counters.destroyedEntities = 0;
+        m_counters.setComponents = 0;
+        m_counters.removedComponents = 0;
+        m_counters.viewIterations = 0;
+    }
+
+    void Hub::setParent(EntityID _child, EntityID _parent)
+    {
+        HierarchyNode & node = ensureHierarchyNode(_child);
+        if (node.parent == _parent)
+            return;
+
+#ifndef NDEBUG
+        //make sure we don't create a cycle
+        for (EntityID p = _parent; p != InvalidEntityID; p = component<Hierarchy>(p) ? (*component<Hierarchy>(p)).parent : InvalidEntityID)
+            STICK_ASSERT(p != _child);
+#endif
+
+        unlinkFromParent(_child, node);
+        if (_parent != InvalidEntityID)
+        {
+            //the component pages never move when components are added, so node stays valid
+            HierarchyNode & parent = ensureHierarchyNode(_parent);
+            node.parent = _parent;
+            node.nextSibling = parent.firstChild;
+            parent.firstChild = _child;
+            updateDepth(_child, parent.depth + 1);
+        }
+        else
+        {
+            updateDepth(_child, 0);
+        }
+        m_bHierarchyDirty = true;
+    }
+
+    HierarchyNode & Hub::ensureHierarchyNode(EntityID _id)
+    {
+        m_bHierarchyUsed = true;
+        auto node = component<Hierarchy>(_id);
+        if (node)
+            return *node;
+        setComponent<Hierarchy>(_id, HierarchyNode {InvalidEntityID, InvalidEntityID, InvalidEntityID, 0});
+        m_bHierarchyDirty = true;
+        return *component<Hierarchy>(_id);
+    }
+
+    void Hub::unlinkFromParent(EntityID _id, HierarchyNode & _node)
+    {
+        if (_node.parent == InvalidEntityID)
+            return;
+
+        HierarchyNode & parent = *component<Hierarchy>(_node.parent);
+        if (parent.firstChild == _id)
+        {
+            parent.firstChild = _node.nextSibling;
+        }
+        else
+        {
+            EntityID sibling = parent.firstChild;
+            while (sibling != InvalidEntityID)
+            {
+                HierarchyNode & sn = *component<Hierarchy>(sibling);
+                if (sn.nextSibling == _id)
+                {
+                    sn.nextSibling = _node.nextSibling;
+                    break;
+                }
+                sibling = sn.nextSibling;
+            }
+        }
+        _node.parent = InvalidEntityID;
+        _node.nextSibling = InvalidEntityID;
+    }
+
+    void Hub::updateDepth(EntityID _id, Size _depth)
+    {
+        DynamicArray<EntityID> stack(*m_alloc);
+        (*component<Hierarchy>(_id)).depth = _depth;
+        stack.append(_id);
+        while (stack.count())
+        {
+            const HierarchyNode & node = *component<Hierarchy>(stack.last());
+            stack.removeLast();
+            for (EntityID c = node.firstChild; c != InvalidEntityID;)
+            {
+                HierarchyNode & cn = *component<Hierarchy>(c);
+                cn.depth = node.depth + 1;
+                stack.append(c);
+                c = cn.nextSibling;
+            }
+        }
+    }
+
+    void Hub::detachHierarchy(EntityID _id)
+    {
+        HierarchyNode & node = *component<Hierarchy>(_id);
+        unlinkFromParent(_id, node);
+        EntityID c = node.firstChild;
+        while (c != InvalidEntityID)
+        {
+            HierarchyNode & cn = *component<Hierarchy>(c);
+            EntityID next = cn.nextSibling;
+            cn.parent = InvalidEntityID;
+            cn.nextSibling = InvalidEntityID;
+            updateDepth(c, 0);
+            c = next;
+        }
+        node.firstChild = InvalidEntityID;
+        m_bHierarchyDirty = true;
+    }
+
+    void Hub::cloneHierarchy(EntityID _from, EntityID _to)
+    {
+        Size hid = componentID<Hierarchy>();
+        if (!m_bHierarchyUsed || !m_componentBitsets[_from][hid] || m_componentBitsets[_to][hid])
+            return;
+        setParent(_to, (*component<Hierarchy>(_from)).parent);
+    }
+
+    void Hub::orderHierarchy()
+    {
+        ComponentStorage * s = storage(componentID<Hierarchy>());
+        if (!s)
+            return;
+        const auto & nodes = storageFor<HierarchyNode>(*const_cast<const ComponentStorage *>(s));
+        Size n = nodes.count();
+
+        //visit the roots in their current iteration order, then the children of every
+        //visited node, which yields all nodes level by level
+        DynamicArray<EntityID> queue(*m_alloc);
+        queue.reserve(n);
+        for (Size i = n; i > 0; --i)
+        {
+            if (nodes.at(i - 1).parent == InvalidEntityID)
+                queue.append(nodes.entities()[i - 1]);
+        }
+        for (Size head = 0; head < queue.count(); ++head)
+        {
+            for (EntityID c = nodes.find(queue[head])->firstChild; c != InvalidEntityID; c = nodes.find(c)->nextSibling)
+                queue.append(c);
+        }
+        STICK_ASSERT(queue.count() == n);
+
+        //views iterate back to front, so the first visited node goes last
+        DynamicArray<Size> order(*m_alloc);
+        order.resize(n);
+        for (Size i = 0; i < n; ++i)
+            order[n - 1 - i] = nodes.m_sparse[queue[i]];
+        storageFor<HierarchyNode>(*s).applyOrder(std::true_type(), order, *m_alloc);
+    }
+
+    Entity Hub::entityForID(EntityID _id) const
+    {
+        if (_id == InvalidEntityID)
+            return Entity();
+        return Entity(const_cast<Hub *>(this), _id, m_handleVersions[_id]);
+    }
+
     Entity Hub::clone(EntityID _id)
     {
         Entity ret = createEntity();
@@ -83,19 +1336,26 @@ namespace brick
 
     void Hub::cloneComponents(EntityID _from, EntityID _to)
     {
+        Size hid = componentID<Hierarchy>();
         for (stick::Size i = 0; i < m_componentStorage.count(); ++i)
         {
             auto & ptr = m_componentStorage[i];
-            if (ptr)
-            {
-                ptr->cloneComponent(_from, _to);
+            //components that can't be cloned are skipped
+            if (ptr && i != hid && m_componentBitsets[_from][i] && ptr->cloneComponent(_from, _to))
                 m_componentBitsets[_to][i] = true;
-            }
         }
+        cloneHierarchy(_from, _to);
+        m_componentBitsets[_to] |= tagBits(m_componentBitsets[_from]);
+        m_entityTypes[_to] = m_entityTypes[_from];
     }
 
     stick::Allocator & Hub::allocator() const
     {
-        return m_componentStorage.allocator();
+        return *m_alloc;
+    }
+
+    const PagedArena & Hub::arena() const
+    {
+        return *m_arena;
     }
 }
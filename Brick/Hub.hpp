@@ -4,80 +4,168 @@
 #include <Stick/DynamicArray.hpp>
 #include <Stick/UniquePtr.hpp>
 #include <Stick/Maybe.hpp>
+#include <Stick/TypeInfo.hpp>
+#include <Brick/Config.hpp>
+#include <Brick/ComponentBuffer.hpp>
+#include <Brick/ComponentIndex.hpp>
+#include <Brick/ComponentObserver.hpp>
+#include <Brick/Delta.hpp>
 #include <Brick/EntityID.hpp>
+#include <Brick/Hierarchy.hpp>
+#include <Brick/PagedArena.hpp>
+#include <Brick/PoolAllocator.hpp>
+#include <Brick/SharedPage.hpp>
+#include <Brick/SpatialIndex.hpp>
+#include <Brick/Stats.hpp>
+#include <Brick/Trace.hpp>
 
 #include <type_traits>
 #include <algorithm>
+#include <atomic>
 #include <bitset>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <utility>
+
+// The counters are always part of the hub so that its layout does not depend on the
+// build options, only the increments are compiled out.
+#ifdef BRICK_ENABLE_COUNTERS
+#define BRICK_COUNT(_hub, _counter, _n) (_hub)->m_counters._counter.fetch_add(_n, std::memory_order_relaxed)
+#else
+#define BRICK_COUNT(_hub, _counter, _n) do {} while (false)
+#endif
 
 namespace brick
 {
     class Entity;
 
-    //@TODO: Add some way to reserve memory/storage for a certain number of entities/components?
-    class Hub
+    namespace detail
     {
-        friend class Entity;
+        // Components are constructed with parentheses if they have a matching
+        // constructor and brace initialized otherwise, so aggregates like
+        // set<Position>(1.0f, 2.0f, 3.0f) keep working.
+        template<class T, class...Args>
+        T * constructComponent(std::true_type, void * _ptr, Args && ..._args)
+        {
+            return new (_ptr) T(std::forward<Args>(_args)...);
+        }
 
-        typedef stick::DynamicArray<stick::Size> FreeList;
-        typedef stick::DynamicArray<stick::Size> HandleVersionArray;
-        typedef std::bitset<64> ComponentBitset;
-        typedef stick::DynamicArray<ComponentBitset> ComponentBitsetArray;
+        template<class T, class...Args>
+        T * constructComponent(std::false_type, void * _ptr, Args && ..._args)
+        {
+            return new (_ptr) T{std::forward<Args>(_args)...};
+        }
 
-        struct FreeListAccessor
+        template<class T, class...Args>
+        T * constructComponent(void * _ptr, Args && ..._args)
         {
-            FreeListAccessor()
-            {}
+            return constructComponent<T>(std::is_constructible<T, Args && ...>(), _ptr, std::forward<Args>(_args)...);
+        }
 
-            FreeListAccessor(Hub * _hub) :
-                m_hub(_hub)
-            {}
+        template<class T, class...Args>
+        struct IsComponentValue : std::false_type {};
 
-            FreeList & freeList()
-            {
-                return m_hub->m_freeList;
-            }
+        template<class T, class A>
+        struct IsComponentValue<T, A> : std::is_same<T, typename std::decay<A>::type> {};
 
-            Hub * m_hub;
-        };
+        // assigning a value of the component type directly avoids a temporary
+        template<class T, class A>
+        void assignComponent(std::true_type, T & _target, A && _value)
+        {
+            _target = std::forward<A>(_value);
+        }
 
-        struct FreeListAccessorConst
+        template<class T, class...Args>
+        void assignComponent(std::false_type, T & _target, Args && ..._args)
         {
-            FreeListAccessorConst()
-            {}
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type tmp;
+            T * value = constructComponent<T>(&tmp, std::forward<Args>(_args)...);
+            _target = std::move(*value);
+            value->~T();
+        }
 
-            FreeListAccessorConst(const Hub * _hub) :
-                m_list(_hub->m_freeList)
-            {}
+        template<class T, class...Args>
+        void assignComponent(T & _target, Args && ..._args)
+        {
+            assignComponent(IsComponentValue<T, Args...>(), _target, std::forward<Args>(_args)...);
+        }
 
-            FreeList & freeList()
-            {
-                return m_list;
-            }
+        // true if T has an operator ==, used to find the snapshot pages that did not change
+        template<class T, class Enable = void>
+        struct IsEqualityComparable : std::false_type {};
+
+        template<class T>
+        struct IsEqualityComparable<T, decltype((void)(std::declval<const T &>() == std::declval<const T &>()))> : std::true_type {};
+
+        // the first of the components C that is not a tag, void if they all are
+        template<class...C>
+        struct FirstStored
+        {
+            using Type = void;
+        };
 
-            FreeList m_list;
+        template<class C, class...Rest>
+        struct FirstStored<C, Rest...>
+        {
+            using Type = typename std::conditional<C::IsTag, typename FirstStored<Rest...>::Type, C>::type;
         };
+    }
+
+    //@TODO: Add some way to reserve memory/storage for a certain number of entities/components?
+    class Hub
+    {
+        friend class Entity;
+
+        typedef stick::DynamicArray<stick::Size> FreeList;
+        typedef stick::DynamicArray<stick::Size> HandleVersionArray;
+        // the TypeID of the typed entity class of each entity, 0 if untyped
+        typedef stick::DynamicArray<stick::TypeID> EntityTypeArray;
 
     public:
 
-        template<bool IsConst, bool All = true>
+        typedef std::bitset<64> ComponentBitset;
+        typedef stick::DynamicArray<ComponentBitset> ComponentBitsetArray;
+
+        // Iterates the entities of the hub in id order. The iterators are random access: an
+        // entity is addressed by its rank among the alive entities, which the sorted free list
+        // of the hub (see sortedFreeList()) turns into an id with a binary search, so jumping
+        // costs O(log(free ids)) rather than a walk. Stepping with ++ and -- walks the free list
+        // along with the id, which is O(1) amortized. Creating or destroying entities invalidates
+        // the iterators.
+        template<bool IsConst>
         class EntityIterator
         {
         public:
 
             typedef typename std::conditional<IsConst, const Hub *, Hub *>::type HubPtr;
             typedef typename std::conditional<IsConst, const Entity, Entity>::type EntityType;
-            typedef typename std::conditional<IsConst, FreeListAccessorConst, FreeListAccessor>::type FreeListAccessorType;
+
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef Entity value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef void pointer;
+            typedef EntityType reference;
 
 
             EntityIterator();
 
-            EntityIterator(HubPtr _hub, stick::Size _current, const ComponentBitset & _mask = ComponentBitset(0));
+            // starts at the first entity at or after _current.
+            EntityIterator(HubPtr _hub, stick::Size _current);
 
             bool operator == (const EntityIterator & _other) const;
 
             bool operator != (const EntityIterator & _other) const;
 
+            bool operator < (const EntityIterator & _other) const;
+
+            bool operator > (const EntityIterator & _other) const;
+
+            bool operator <= (const EntityIterator & _other) const;
+
+            bool operator >= (const EntityIterator & _other) const;
+
             EntityIterator & operator--();
 
             EntityIterator operator--(int);
@@ -94,33 +182,92 @@ namespace brick
 
             EntityIterator operator+(stick::Size _i) const;
 
+            // number of entities from _other to this iterator.
+            difference_type operator-(const EntityIterator & _other) const;
+
             void increment();
 
             void decrement();
 
             inline EntityType operator * () const;
 
+            EntityType operator [] (stick::Size _i) const;
+
         private:
 
-            bool isValidEntity();
+            // the rank of the current entity among the alive entities
+            stick::Size rank() const;
+
+            // moves to the alive entity with _rank, the end if there is none.
+            void moveToRank(stick::Size _rank);
 
             HubPtr m_hub;
+            // the sorted free list of the hub, shared by all its iterators
+            const FreeList * m_freeList;
             stick::Size m_current;
+            // number of free ids below m_current
             stick::Size m_freeListIndex;
+        };
+
+        typedef EntityIterator<false> Iter;
+        typedef EntityIterator<true> ConstIter;
+
+        // Iterates the entities of a view in the packed order of the storage of the
+        // first component of the view that is not a tag. The packed array is walked back
+        // to front, which makes it safe to remove components from or destroy the current
+        // entity. Views of nothing but tags don't have a packed array to walk, they scan
+        // the component bitsets of all entities instead (_entities is nullptr).
+        template<bool IsConst>
+        class ViewIterator
+        {
+        public:
+
+            typedef typename std::conditional<IsConst, const Hub *, Hub *>::type HubPtr;
+            typedef typename std::conditional<IsConst, const Entity, Entity>::type EntityType;
+
+
+            ViewIterator();
+
+            ViewIterator(HubPtr _hub, const stick::DynamicArray<EntityID> * _entities, stick::Size _position, const ComponentBitset & _mask);
+
+            bool operator == (const ViewIterator & _other) const;
+
+            bool operator != (const ViewIterator & _other) const;
+
+            ViewIterator & operator++();
+
+            ViewIterator operator++(int);
+
+            inline EntityType operator * () const;
+
+        private:
+
+            void skip();
+
+            bool isValidEntity() const;
+
+            HubPtr m_hub;
+            const stick::DynamicArray<EntityID> * m_entities;
+            //one past the packed index of the current entity, 0 is the end
+            stick::Size m_position;
             ComponentBitset m_mask;
-            FreeListAccessorType m_freeListAccessor;
         };
 
-        typedef EntityIterator<false, true> Iter;
-        typedef EntityIterator<true, true> ConstIter;
+        template<class...C>
+        class Chunk;
+
+        template<class...C>
+        class ChunkRange;
 
         template<class...C>
         class TypedEntityRange
         {
         public:
 
-            typedef EntityIterator<false, false> Iter;
-            typedef EntityIterator<true, false> ConstIter;
+            static_assert(sizeof...(C) > 0, "views need at least one component");
+
+            typedef ViewIterator<false> Iter;
+            typedef ViewIterator<true> ConstIter;
 
             TypedEntityRange(Hub * _hub) :
                 m_hub(_hub)
@@ -130,22 +277,170 @@ namespace brick
 
             Iter begin()
             {
-                return Iter(m_hub, 0, m_hub->template componentMask<C...>());
+                BRICK_TRACE_SCOPE("Hub::view::begin");
+                auto * entities = leadEntities();
+                return Iter(m_hub, entities, beginPosition(entities), m_hub->template componentMask<C...>());
             }
 
             ConstIter begin() const
             {
-                return ConstIter(m_hub, 0, m_hub->template componentMask<C...>());
+                BRICK_TRACE_SCOPE("Hub::view::begin");
+                auto * entities = leadEntities();
+                return ConstIter(m_hub, entities, beginPosition(entities), m_hub->template componentMask<C...>());
             }
 
             Iter end()
             {
-                return Iter(m_hub, m_hub->m_nextEntityID, m_hub->template componentMask<C...>());
+                return Iter(m_hub, leadEntities(), 0, ComponentBitset());
             }
 
             ConstIter end() const
             {
-                return ConstIter(m_hub, m_hub->m_nextEntityID, m_hub->template componentMask<C...>());
+                return ConstIter(m_hub, leadEntities(), 0, ComponentBitset());
+            }
+
+            // Number of entities the view iterates. O(1) for views of a single component that
+            // is not a tag, other views count the entities of their lead storage (or all entity
+            // ids for views of tags only) that have all components.
+            stick::Size size() const
+            {
+                ComponentBitset mask = m_hub->template componentMask<C...>();
+                const stick::DynamicArray<EntityID> * entities = leadEntities();
+                stick::Size ret = 0;
+                if (std::is_void<Lead>::value)
+                {
+                    for (stick::Size i = 0; i < m_hub->m_nextEntityID; ++i)
+                        ret += (m_hub->m_componentBitsets[i] & mask) == mask;
+                }
+                else if (entities && sizeof...(C) == 1)
+                {
+                    ret = entities->count();
+                }
+                else if (entities)
+                {
+                    for (EntityID id : *entities)
+                        ret += (m_hub->m_componentBitsets[id] & mask) == mask;
+                }
+                return ret;
+            }
+
+            // Splits the packed storage of the lead component of the view into chunks of at most
+            // _size components that can be handed to a job system, see ChunkRange.
+            ChunkRange<C...> chunks(stick::Size _size) const
+            {
+                return ChunkRange<C...>(m_hub, _size);
+            }
+
+        private:
+
+            using Lead = typename detail::FirstStored<C...>::Type;
+
+            const stick::DynamicArray<EntityID> * leadEntities() const
+            {
+                return leadEntities(std::is_void<Lead>());
+            }
+
+            const stick::DynamicArray<EntityID> * leadEntities(std::false_type) const
+            {
+                const ComponentStorage * storage = m_hub->storage(m_hub->template componentID<Lead>());
+                return storage ? &storage->entities() : nullptr;
+            }
+
+            const stick::DynamicArray<EntityID> * leadEntities(std::true_type) const
+            {
+                return nullptr;
+            }
+
+            stick::Size beginPosition(const stick::DynamicArray<EntityID> * _entities) const
+            {
+                if (std::is_void<Lead>::value)
+                    return m_hub->m_nextEntityID;
+                return _entities ? _entities->count() : 0;
+            }
+
+            Hub * m_hub;
+        };
+
+
+        // Iterates all entities whose entity type is the TypeID of T by scanning the
+        // dense type array of the hub. Dereferencing yields a T referencing the entity.
+        template<class T>
+        class EntityTypeRange
+        {
+        public:
+
+            class Iter
+            {
+            public:
+
+                Iter(Hub * _hub, EntityID _current) :
+                    m_hub(_hub),
+                    m_current(_current),
+                    m_type(stick::TypeInfoT<T>::typeID())
+                {
+                    skip();
+                }
+
+                Iter & operator++()
+                {
+                    ++m_current;
+                    skip();
+                    return *this;
+                }
+
+                Iter operator++(int)
+                {
+                    Iter ret = *this;
+                    ++(*this);
+                    return ret;
+                }
+
+                bool operator == (const Iter & _other) const
+                {
+                    return m_current == _other.m_current;
+                }
+
+                bool operator != (const Iter & _other) const
+                {
+                    return m_current != _other.m_current;
+                }
+
+                T operator*() const
+                {
+                    T ret;
+                    ret.assignEntity(m_hub->entityForID(m_current));
+                    return ret;
+                }
+
+            private:
+
+                void skip()
+                {
+                    //free ids have type 0, so this also skips dead entities
+                    const EntityTypeArray & types = m_hub->m_entityTypes;
+                    while (m_current < types.count() && types[m_current] != m_type)
+                        ++m_current;
+                }
+
+                Hub * m_hub;
+                EntityID m_current;
+                stick::TypeID m_type;
+            };
+
+            EntityTypeRange(Hub * _hub) :
+                m_hub(_hub)
+            {
+
+            }
+
+            Iter begin() const
+            {
+                return Iter(m_hub, 0);
+            }
+
+            Iter end() const
+            {
+                return Iter(m_hub, m_hub->m_nextEntityID);
             }
 
         private:
@@ -154,12 +449,205 @@ namespace brick
         };
 
 
-        Hub(stick::Allocator & _allocator = stick::defaultAllocator());
+        // All memory of the hub (entity bookkeeping, component storages and component pages)
+        // comes from an internal PagedArena that requests pages of _arenaPageSize bytes from _allocator.
+        Hub(stick::Allocator & _allocator = stick::defaultAllocator(), stick::Size _arenaPageSize = PagedArena::DefaultPageSize);
 
         ~Hub();
 
+        Hub(const Hub &) = delete;
+
+        Hub & operator = (const Hub &) = delete;
+
         Entity createEntity();
 
+        // Destroys all entities and components. Instead of freeing every allocation
+        // individually the arena is rewound, so this only touches the components that need
+        // a destructor call. The arena pages are kept around to be reused. Handles to
+        // entities of the hub are invalid afterwards.
+        void clear();
+
+        // Like clear() but also gives the arena pages back to the allocator of the hub.
+        void release();
+
+        using RemapFunction = std::function<void(const Entity & _old, const Entity & _new)>;
+
+        // Moves all live entities into the dense id range [0, entityCount()) keeping their
+        // relative order and rebuilds all storages in a new arena, giving the memory of the old
+        // one back to the allocator. Entities that moved get a new handle, _fn is called for
+        // each of them so that stored handles can be remapped (compare them against _old).
+        // Handles to moved entities are invalid afterwards.
+        void compact(const RemapFunction & _fn = RemapFunction());
+
+        // Drops the free entity ids at the end of the id range and rebuilds all storages
+        // in a new arena. Does not move any entity, so all handles stay valid.
+        void shrinkToFit();
+
+        // Moves _entity with all its components to a new entity of _target and destroys it
+        // in this hub. Components are moved column by column (memcpy for trivially
+        // copyable ones), nothing is copied. Hierarchy links can't span hubs, so the
+        // entity is detached from its parent and children first. Returns the new entity.
+        Entity migrate(const Entity & _entity, Hub & _target);
+
+        // Moves all entities of _view to _target, see migrate(). Each component storage
+        // is walked once for the whole batch. _fn is called with the old and the new
+        // handle of every migrated entity. Returns the number of migrated entities.
+        template<class...C>
+        stick::Size migrate(const TypedEntityRange<C...> & _view, Hub & _target, const RemapFunction & _fn = RemapFunction());
+
+        // Moves all entities of _staging into this hub and clears _staging. The staging hub
+        // can be filled on another thread (i.e. while streaming in a level) as long as only
+        // that thread touches it. Entity i of _staging becomes entity i + the id range of this
+        // hub, so the remapping is an offset and every component storage is moved with one
+        // bulk append (memcpy for trivially copyable components). Handles to entities of
+        // _staging are invalid afterwards, _fn is called with the old and the new handle of
+        // every entity so that they can be remapped. Returns the number of moved entities.
+        stick::Size splice(Hub & _staging, const RemapFunction & _fn = RemapFunction());
+
+        // Returns the buffer through which another thread can read the state of the components T
+        // as of the last swapBuffers() call, creating it on the first call. The buffer lives as
+        // long as the hub, so the reader can keep the reference and never touches the hub.
+        template<class T>
+        ComponentBuffer<typename T::ValueType> & componentBuffer();
+
+        // Publishes the current state of the components T... to their buffers, see
+        // componentBuffer(). Call it from the thread that writes the components, i.e. at the
+        // end of a simulation step. The buffers share the page copies of the storage with the
+        // snapshots, only the pages that changed since they were last published or captured
+        // are copied. Readers pick up the published state with acquire().
+        template<class...T>
+        void swapBuffers();
+
+        // Sets the hub wide value of the component T, i.e. time, input or configuration that
+        // would otherwise live on a dummy entity. Singletons are not attached to any entity, so
+        // they take one slot no matter how many entities there are. The value is constructed
+        // from _args the first time and assigned afterwards like the components of Entity::set(),
+        // so aggregates can be set from their fields, too. It stays at the same address
+        // until removeSingleton<T>() or the destruction of the hub. Singletons survive clear()
+        // and compact() and are not part of snapshots and deltas.
+        template<class T, class...Args>
+        typename T::ValueType & setSingleton(Args && ..._args);
+
+        // the value set by setSingleton<T>().
+        template<class T>
+        typename T::ValueType & singleton();
+
+        template<class T>
+        const typename T::ValueType & singleton() const;
+
+        template<class T>
+        bool hasSingleton() const;
+
+        template<class T>
+        void removeSingleton();
+
+        // The state of a hub captured by snapshot().
+        class Snapshot;
+
+        // Captures the state of all entities and components, i.e. to roll back to it with
+        // restore(). The component pages are shared between the hub and its snapshots: every
+        // page is compared with the copy the last snapshot made of it (memcmp for trivially
+        // copyable components, operator == for others) and only copied if it changed, so the
+        // memory and the copying of a snapshot per frame are in the order of the pages written
+        // during the frame. Comparing is a linear pass without allocations. Nothing is tracked
+        // while components are accessed, so concurrent readers don't touch shared state and
+        // writes through references taken before the snapshot are caught, too. Components that
+        // are neither trivially copyable nor have an operator == are copied by every snapshot.
+        // The entity bookkeeping (component bitsets, handle versions, entity types and the free
+        // list) is copied as a whole. Components that are not trivially copyable are copied
+        // with their CloneTrait. Components that can't be cloned (i.e. move only ones or the
+        // ref counters of SharedEntity) are not captured at all, see restore().
+        Snapshot snapshot();
+
+        // Puts the hub back into the state of _snapshot, which can come from any hub. Only the
+        // pages that differ from the snapshot are copied back, see snapshot(). Handles that were valid when
+        // the snapshot was taken are valid again, entities that get recreated in the same
+        // order after a rollback get the same handles as before. Components that can't be
+        // cloned are not part of the snapshot, they stay with the entities that are alive with
+        // the same handle in both the hub and the snapshot and are removed from all others.
+        void restore(const Snapshot & _snapshot);
+
+        // Encodes the changes from _baseline to _current (i.e. two consecutive snapshots of a
+        // server hub) as a compact binary delta for applyDelta(). Only the pages the snapshots
+        // don't share are compared, so the cost scales with the changes rather than the size of
+        // the world. The delta holds the entities whose handle version changed (created or
+        // destroyed), the free list if it changed and the changed pages of all trivially
+        // copyable components, keyed by their name hash, and the entities whose tags changed.
+        // With _bXorRle every page is XORed with
+        // its baseline and run length encoded, so unchanged bytes cost next to nothing. Entity
+        // types and components that are not trivially copyable are not part of the delta. The
+        // delta uses the byte order of the machine.
+        static stick::DynamicArray<stick::UInt8> diff(const Snapshot & _baseline, const Snapshot & _current,
+                bool _bXorRle = true, stick::Allocator & _alloc = stick::defaultAllocator());
+
+        // Applies a delta created by diff(). The hub needs to be in the state of the baseline
+        // of the delta, i.e. a client hub that only ever got its state from deltas. Components
+        // the delta does not cover are removed from the entities it destroys, components that
+        // were never used in this process are skipped. Returns false and leaves the hub
+        // untouched if the delta is malformed or its baseline has a different number of entities.
+        bool applyDelta(const stick::UInt8 * _data, stick::Size _byteCount);
+
+        // Adds an observer that gets told about the changes to the components T, see
+        // ComponentObserver. The existing components are reported right away. The observer
+        // lives as long as the hub.
+        template<class T>
+        ComponentObserver & addObserver(stick::UniquePtr<ComponentObserver> _observer);
+
+        // Indexes the components T in a uniform grid with cells of _cellSize, see SpatialIndex
+        // and SpatialTrait. The index is an observer of T, so it stays up to date as long as
+        // T is written with set() or replace() rather than through the reference get() returns.
+        template<class T>
+        SpatialIndex & enableSpatialIndex(stick::Float32 _cellSize);
+
+        // the index created by enableSpatialIndex<T>().
+        template<class T>
+        const SpatialIndex & spatialIndex() const;
+
+        // Appends the entities whose T overlaps _bounds to _out using the spatial index of T.
+        // Returns the number of appended entities.
+        template<class T>
+        stick::Size query(const AABB & _bounds, stick::DynamicArray<Entity> & _out) const;
+
+        template<class T>
+        stick::DynamicArray<Entity> query(const AABB & _bounds) const;
+
+        // Indexes the entities by the value of their component T, see ComponentIndex and
+        // IndexKeyTrait. Like the spatial index, it only sees writes through set() and replace().
+        // Unique indices assert that no two entities share a key.
+        template<class T>
+        ComponentIndex<typename T::ValueType> & enableIndex(bool _bUnique = true);
+
+        // Indexes the entities by the key _keyFn returns for their component T, i.e. a field:
+        // hub.enableIndex<Asset>([](const AssetData & _asset) { return _asset.guid; });
+        template<class T, class F>
+        ComponentIndex<typename std::decay<typename std::result_of<F(const typename T::ValueType &)>::type>::type> &
+        enableIndex(F _keyFn, bool _bUnique = true);
+
+        // the index created by enableIndex<T>(), K is the key type of the index.
+        template<class T, class K = typename T::ValueType>
+        const ComponentIndex<K> & index() const;
+
+        // Returns the entity whose component T has _key using the index of T, an invalid
+        // entity if there is none. For non unique indices it returns any of the entities with _key.
+        template<class T, class K = typename T::ValueType>
+        Entity find(const typename detail::NonDeduced<K>::Type & _key) const;
+
+        // Appends all entities whose component T has _key to _out, returns their number.
+        template<class T, class K = typename T::ValueType>
+        stick::Size findAll(const typename detail::NonDeduced<K>::Type & _key, stick::DynamicArray<Entity> & _out) const;
+
+        // Queues _entity to be destroyed by the next call to collectGarbage(). This
+        // only locks the queue, so it can be called from any thread.
+        void queueDestroy(const Entity & _entity);
+
+        // Destroys all queued entities in one batch, walking each component storage
+        // once rather than once per entity. Entities queued while collecting (i.e. by
+        // components releasing SharedEntities) are collected, too. Entities that were
+        // destroyed since they got queued are skipped. Returns the number of destroyed entities.
+        stick::Size collectGarbage();
+
+        stick::Size queuedDestroyCount() const;
+
         template<class...Components>
         void reserve(stick::Size _count);
 
@@ -183,6 +671,8 @@ namespace brick
             return ConstIter(this, m_nextEntityID);
         }
 
+        // Iterates all entities that have all the components C. The iteration follows the
+        // packed order of the first component, see sort() and sortByEntityOrder().
         template<class...C>
         TypedEntityRange<C...> view()
         {
@@ -195,19 +685,94 @@ namespace brick
             return TypedEntityRange<C...>(this);
         }
 
+        // Iterates all entities created as T, see createEntity<T>() in TypedEntity.hpp.
+        template<class T>
+        EntityTypeRange<T> viewOfType()
+        {
+            return EntityTypeRange<T>(this);
+        }
+
         stick::Size entityCount() const;
 
+        // Collects memory statistics of all component storages and the entity bookkeeping.
+        // Walks all storages, so this is meant for diagnostics rather than every frame.
+        HubStats stats() const;
+
+        // sets the counters reported by stats() back to zero.
+        void resetCounters();
+
+        // the allocator the hub was constructed with.
         stick::Allocator & allocator() const;
 
+        const PagedArena & arena() const;
+
+        template <class ... Components>
+        ComponentBitset componentMask() const
+        {
+            //component ids are global, so the mask of a set of components only
+            //needs to be built once
+            static const ComponentBitset s_mask = buildComponentMask<Components...>();
+            return s_mask;
+        }
+
+        // Physically reorders the packed storage of T so that views led by T iterate
+        // in the order defined by _compare(const ValueType &, const ValueType &). The
+        // storages of Dependents are reordered to follow the new order of T afterwards.
+        template<class T, class...Dependents, class F>
+        void sort(F _compare);
+
+        // Reorders the packed storage of T so that the entities that also have U
+        // come first and in the same order as they are iterated in U.
+        template<class T, class U>
+        void sortByEntityOrder();
+
+        // Orders the Hierarchy storage breadth first (level by level, the children of every
+        // level in the order of their parents, siblings next to each other) if the hierarchy
+        // changed since the last call and makes the storages of Dependents follow that order. Afterwards
+        // view<Hierarchy, Dependents...>() is a single linear pass that visits every
+        // parent before its children, i.e. for transform propagation.
+        template<class...Dependents>
+        void sortHierarchy();
+
     private:
 
+
         template<class...Comps>
         friend struct ContainsHelper;
 
         Entity createNextEntity();
 
+        // m_freeList in ascending order, which the entity iterators share. It is rebuilt on
+        // the first use after the free list changed. Const so that the iterators of several
+        // systems can request it at once.
+        const FreeList & sortedFreeList() const;
+
+        // needs to be called whenever m_freeList changes.
+        void freeListChanged()
+        {
+            m_bSortedFreeListValid.store(false, std::memory_order_relaxed);
+        }
+
+        // moves the state of the hub into a new arena. _remap maps every current entity id
+        // to its new id or InvalidEntityID if it is dropped (only free ids may be dropped).
+        void rebuild(const stick::DynamicArray<EntityID> & _remap, stick::Size _count);
+
         void destroyEntity(const Entity & _entity);
 
+        struct QueuedDestroy
+        {
+            EntityID id;
+            stick::Size version;
+        };
+
+        using DestroyQueue = stick::DynamicArray<QueuedDestroy>;
+
+        // returns the number of entities that were still alive
+        stick::Size destroyEntities(const DestroyQueue & _entities);
+
+        // moves the entities _ids to new entities in _target and appends their ids to _targetIDs.
+        void migrateEntities(const stick::DynamicArray<EntityID> & _ids, Hub & _target, stick::DynamicArray<EntityID> & _targetIDs);
+
         bool isValid(EntityID _id, stick::Size _version) const;
 
         template<class Component>
@@ -218,64 +783,157 @@ namespace brick
 
 
         template<class T, class ... Args>
-        void setComponent(EntityID _id, Args ..._args)
+        typename T::ValueType & setComponent(EntityID _id, Args && ..._args)
         {
-            using ValueType = typename T::ValueType;
-            stick::Size cid = componentID<T>();
+            BRICK_TRACE_SCOPE("Hub::setComponent");
+            BRICK_COUNT(this, setComponents, 1);
+            return setComponentImpl<T>(std::integral_constant<bool, T::IsTag>(), _id, std::forward<Args>(_args)...);
+        }
 
-            if (m_componentStorage.count() <= cid)
-            {
-                m_componentStorage.resize(cid + 1);
-            }
-            auto & storage = m_componentStorage[cid];
-            if (!storage)
+        template<class T, class ... Args>
+        typename T::ValueType & setComponentImpl(std::false_type, EntityID _id, Args && ..._args)
+        {
+            auto & ret = storageFor<typename T::ValueType>(ensureStorage<T>()).emplace(_id, std::forward<Args>(_args)...);
+            m_componentBitsets[_id][componentID<T>()] = true;
+            return ret;
+        }
+
+        template<class T, class ... Args>
+        typename T::ValueType & setComponentImpl(std::true_type, EntityID _id, Args && ...)
+        {
+            m_componentBitsets[_id][componentID<T>()] = true;
+            return tagValue<typename T::ValueType>();
+        }
+
+        template<class T, class ... Args>
+        typename T::ValueType & replaceComponent(EntityID _id, Args && ..._args)
+        {
+            BRICK_TRACE_SCOPE("Hub::replaceComponent");
+            BRICK_COUNT(this, setComponents, 1);
+            return replaceComponentImpl<T>(std::integral_constant<bool, T::IsTag>(), _id, std::forward<Args>(_args)...);
+        }
+
+        template<class T, class ... Args>
+        typename T::ValueType & replaceComponentImpl(std::false_type, EntityID _id, Args && ..._args)
+        {
+            auto & storage = storageFor<typename T::ValueType>(ensureStorage<T>());
+            STICK_ASSERT(storage.contains(_id));
+            return storage.emplace(_id, std::forward<Args>(_args)...);
+        }
+
+        template<class T, class ... Args>
+        typename T::ValueType & replaceComponentImpl(std::true_type, EntityID _id, Args && ...)
+        {
+            STICK_ASSERT(m_componentBitsets[_id][componentID<T>()]);
+            return tagValue<typename T::ValueType>();
+        }
+
+        // tags don't store anything, so all of them share one instance of the empty value type.
+        template<class VT>
+        static VT & tagValue()
+        {
+            static VT s_value;
+            return s_value;
+        }
+
+        // the bits of _bits that belong to tags, i.e. that don't have a storage.
+        ComponentBitset tagBits(const ComponentBitset & _bits) const
+        {
+            ComponentBitset ret = _bits;
+            for (stick::Size i = 0; i < m_componentStorage.count(); ++i)
             {
-                createStorageForComponentID<ValueType>(cid, m_nextEntityID);
+                if (m_componentStorage[i])
+                    ret[i] = false;
             }
-            (*storage).componentArray<ValueType>()[_id] = (ValueType) {std::forward<Args>(_args)...};
-            m_componentBitsets[_id][cid] = true;
+            return ret;
         }
 
         template<class VT>
         void createStorageForComponentID(stick::Size _cid, stick::Size _count)
         {
-            ComponentStorage * storage = m_alloc->create<ComponentStorageT<VT>>(*m_alloc);
+            ComponentStorage * storage = m_arena->create<ComponentStorageT<VT>>(*m_arena);
             storage->resize(_count);
-            m_componentStorage[_cid] = stick::UniquePtr<ComponentStorage>(storage, *m_alloc);
+            m_componentStorage[_cid] = stick::UniquePtr<ComponentStorage>(storage, *m_arena);
+            attachObservers(_cid);
         }
 
+        void addObserver(stick::Size _componentID, stick::UniquePtr<ComponentObserver> _observer);
+
+        // hands the observers of the component to its storage, i.e. after the storage was recreated.
+        void attachObservers(stick::Size _componentID);
+
         template<class T>
         void removeComponent(EntityID _id)
         {
+            BRICK_TRACE_SCOPE("Hub::removeComponent");
             stick::Size cid = componentID<T>();
-            if (m_componentStorage.count() > cid)
+            if (T::IsTag)
+            {
+                if (m_componentBitsets[_id][cid])
+                {
+                    m_componentBitsets[_id][cid] = false;
+                    BRICK_COUNT(this, removedComponents, 1);
+                }
+            }
+            else if (m_componentStorage.count() > cid && m_componentStorage[cid])
             {
-                m_componentStorage[cid]->componentArray<typename T::ValueType>()[_id].reset();
+                //the parent, children and siblings must not keep links to the entity
+                if (std::is_same<T, Hierarchy>::value && m_componentBitsets[_id][cid])
+                    detachHierarchy(_id);
+                m_componentStorage[cid]->resetComponent(_id);
                 m_componentBitsets[_id][cid] = false;
+                BRICK_COUNT(this, removedComponents, 1);
             }
         }
 
         template<class T>
         stick::Maybe<typename T::ValueType &> component(EntityID _id)
         {
-            using ValueType = typename T::ValueType;
-            stick::Size cid = componentID<T>();
-            if (m_componentStorage.count() <= cid)
-                return stick::Maybe<ValueType &>();
-            auto & storage = m_componentStorage[cid];
-            if (!storage)
-                return stick::Maybe<ValueType &>();
-
-            //this is kind of ugly right now as we need to do the lookup
-            //twice to ensure we return a valid reference
-            if ((*storage).componentArray<ValueType>()[_id])
-                return *(*storage).componentArray<ValueType>()[_id];
-
-            return stick::Maybe<ValueType &>();
+            return componentImpl<T>(std::integral_constant<bool, T::IsTag>(), _id);
         }
 
         template<class T>
         stick::Maybe<const typename T::ValueType &> component(EntityID _id) const
+        {
+            return componentImpl<T>(std::integral_constant<bool, T::IsTag>(), _id);
+        }
+
+        template<class T>
+        stick::Maybe<typename T::ValueType &> componentImpl(std::true_type, EntityID _id)
+        {
+            if (m_componentBitsets[_id][componentID<T>()])
+                return tagValue<typename T::ValueType>();
+            return stick::Maybe<typename T::ValueType &>();
+        }
+
+        template<class T>
+        stick::Maybe<const typename T::ValueType &> componentImpl(std::true_type, EntityID _id) const
+        {
+            if (m_componentBitsets[_id][componentID<T>()])
+                return tagValue<typename T::ValueType>();
+            return stick::Maybe<const typename T::ValueType &>();
+        }
+
+        template<class T>
+        stick::Maybe<typename T::ValueType &> componentImpl(std::false_type, EntityID _id)
+        {
+            using ValueType = typename T::ValueType;
+            stick::Size cid = componentID<T>();
+            if (m_componentStorage.count() <= cid)
+                return stick::Maybe<ValueType &>();
+            auto & storage = m_componentStorage[cid];
+            if (!storage)
+                return stick::Maybe<ValueType &>();
+
+            auto * value = storageFor<ValueType>(*storage).find(_id);
+            if (value)
+                return *value;
+
+            return stick::Maybe<ValueType &>();
+        }
+
+        template<class T>
+        stick::Maybe<const typename T::ValueType &> componentImpl(std::false_type, EntityID _id) const
         {
             using ValueType = typename T::ValueType;
             stick::Size cid = componentID<T>();
@@ -285,10 +943,9 @@ namespace brick
             if (!storage)
                 return stick::Maybe<const ValueType &>();
 
-            //this is kind of ugly right now as we need to do the lookup
-            //twice to ensure we return a valid reference
-            if ((*storage).componentArray<ValueType>()[_id])
-                return *(*storage).componentArray<ValueType>()[_id];
+            const auto * value = storageFor<ValueType>(*storage).find(_id);
+            if (value)
+                return *value;
 
             return stick::Maybe<const ValueType &>();
         }
@@ -300,183 +957,1394 @@ namespace brick
             return m_componentBitsets[_id][cid];
         }
 
-        template <class C>
-        bool contains(stick::Size _componentID) const
+        template <class C>
+        bool contains(stick::Size _componentID) const
+        {
+            return componentID<C>() == _componentID;
+        }
+
+        template <class C1, class C2, class ... Components>
+        bool contains(stick::Size _componentID) const
+        {
+            return contains<C1>(_componentID) || contains<C2, Components ...>(_componentID);
+        }
+
+        void setParent(EntityID _child, EntityID _parent);
+
+        HierarchyNode & ensureHierarchyNode(EntityID _id);
+
+        void unlinkFromParent(EntityID _id, HierarchyNode & _node);
+
+        void updateDepth(EntityID _id, stick::Size _depth);
+
+        // makes the children of _id roots and removes _id from its parent.
+        void detachHierarchy(EntityID _id);
+
+        // Hierarchy links can't be copied, so instead of cloning the node of _from the clone
+        // _to becomes a sibling of _from, unless it is part of the hierarchy already.
+        void cloneHierarchy(EntityID _from, EntityID _to);
+
+        // puts the Hierarchy storage into breadth first order, see sortHierarchy().
+        void orderHierarchy();
+
+        Entity entityForID(EntityID _id) const;
+
+        Entity clone(EntityID _id);
+
+        template<class ... Components>
+        Entity cloneWithout(EntityID _id);
+
+        template<class ... Components>
+        Entity cloneWith(EntityID _id);
+
+        void cloneComponents(EntityID _from, EntityID _to);
+
+        template<class ... Components>
+        void cloneComponents(EntityID _from, EntityID _to);
+
+        template<class ... Components>
+        void cloneComponentsWithout(EntityID _from, EntityID _to);
+
+        template<class T>
+        stick::Size componentID() const
+        {
+            //TODO: find a solution that does not rely on
+            //static to make sure component ids are hub specific.
+            using VT = typename T::ValueType;
+            static stick::Size id = registerComponent({T::hash(), stick::TypeInfoT<T>::typeID(), T::cString(),
+                                    T::IsTag ? nullptr : &createStorage<VT>,
+                                    T::IsTag ? 0 : sizeof(VT), std::is_trivially_copyable<VT>::value});
+            return id;
+        }
+
+        struct ComponentStorage;
+
+        typedef stick::UniquePtr<ComponentStorage> (*StorageFactory)(stick::Allocator & _alloc);
+
+        struct ComponentRecord
+        {
+            stick::UInt64 hash;
+            stick::TypeID type;
+            const char * name;
+            // creates an empty storage, i.e. for a component that only arrives through a delta.
+            // nullptr for tags.
+            StorageFactory factory;
+            // layout of the values, so a delta can be validated before any storage is created
+            stick::Size valueSize;
+            bool bTriviallyCopyable;
+        };
+
+        static std::mutex & componentRegistryMutex();
+
+        // indexed by component id
+        static stick::DynamicArray<ComponentRecord> & componentRegistry();
+
+        // Hands out the dense index of a component that is used for the bitsets and
+        // storages. Asserts if a different component with the same name hash was
+        // registered before. Thread safe, so components first used from different
+        // systems/threads get unique ids.
+        static stick::Size registerComponent(const ComponentRecord & _record);
+
+        // returns the id of the component registered with _hash or InvalidIndex.
+        static stick::Size findComponent(stick::UInt64 _hash, ComponentRecord & _outRecord);
+
+        template<class VT>
+        static stick::UniquePtr<ComponentStorage> createStorage(stick::Allocator & _alloc)
+        {
+            return stick::UniquePtr<ComponentStorage>(_alloc.create<ComponentStorageT<VT>>(_alloc), _alloc);
+        }
+
+        template<class C>
+        ComponentBitset buildComponentMask() const
+        {
+            ComponentBitset mask;
+            mask.set(componentID<C>());
+            return mask;
+        }
+
+        template<class C1, class C2, class...Components>
+        ComponentBitset buildComponentMask() const
+        {
+            return buildComponentMask<C1>() | buildComponentMask<C2, Components...>();
+        }
+
+        struct SnapshotColumn;
+
+        // one changed page of a delta, see applyDelta().
+        struct DeltaPage
+        {
+            stick::Size index;
+            bool bXorRle;
+            DeltaReader entities;
+            DeltaReader values;
+        };
+
+        // Sparse set that maps entity ids to a packed array of components. The
+        // non typed part only deals with the entity ids, ComponentStorageBaseT
+        // keeps the component values in the same packed order.
+        struct ComponentStorage
+        {
+            static constexpr stick::Size InvalidIndex = static_cast<stick::Size>(-1);
+
+
+            ComponentStorage(stick::Allocator & _alloc) :
+                m_entities(_alloc),
+                m_sparse(_alloc),
+                m_observers(_alloc)
+            {
+            }
+
+            virtual ~ComponentStorage()
+            {
+            }
+
+            bool contains(EntityID _id) const
+            {
+                return _id < m_sparse.count() && m_sparse[_id] != InvalidIndex;
+            }
+
+            stick::Size count() const
+            {
+                return m_entities.count();
+            }
+
+            const stick::DynamicArray<EntityID> & entities() const
+            {
+                return m_entities;
+            }
+
+            // makes sure that the storage can address _s entities.
+            void resize(stick::Size _s)
+            {
+                //never shrink
+                if (_s > m_sparse.count())
+                {
+                    stick::Size old = m_sparse.count();
+                    m_sparse.resize(_s);
+                    for (stick::Size i = old; i < _s; ++i)
+                        m_sparse[i] = InvalidIndex;
+                }
+            }
+
+            // swaps the packed positions of the components at _a and _b.
+            void swapPacked(stick::Size _a, stick::Size _b)
+            {
+                if (_a == _b)
+                    return;
+                swapValues(_a, _b);
+                std::swap(m_entities[_a], m_entities[_b]);
+                m_sparse[m_entities[_a]] = _a;
+                m_sparse[m_entities[_b]] = _b;
+            }
+
+            // reorders the storage so that the entities it shares with _other are
+            // iterated in the same order as in _other.
+            void sortByEntityOrder(const ComponentStorage & _other)
+            {
+                //views iterate back to front, so we fill in from the back, too
+                stick::Size pos = count();
+                for (stick::Size i = _other.count(); i > 0 && pos > 0; --i)
+                {
+                    EntityID e = _other.m_entities[i - 1];
+                    if (contains(e))
+                        swapPacked(m_sparse[e], --pos);
+                }
+            }
+
+            // allocates storage for _s components up front.
+            virtual void reserve(stick::Size _s) = 0;
+
+            // copies the component of _from to _to using the CloneTrait of the component.
+            // Returns false if the component can't be cloned or _from does not have it.
+            virtual bool cloneComponent(stick::Size _from, stick::Size _to) = 0;
+
+            virtual void resetComponent(stick::Size _index) = 0;
+
+            virtual void swapValues(stick::Size _a, stick::Size _b) = 0;
+
+            // moves all components into _target, which has to store the same component type,
+            // using _remap to map the entity ids. Entities that map to InvalidEntityID are skipped.
+            // The storage needs to be destroyed or reset afterwards.
+            virtual void moveAll(ComponentStorage & _target, const stick::DynamicArray<EntityID> & _remap) = 0;
+
+            // creates an empty storage for the same component type.
+            virtual stick::UniquePtr<ComponentStorage> createEmpty(stick::Allocator & _alloc) const = 0;
+
+            // moves the components of the entities _from into _target, which stores the same
+            // component type, as the components of the entities _to and removes them here.
+            virtual void migrate(ComponentStorage & _target, const stick::DynamicArray<EntityID> & _from, const stick::DynamicArray<EntityID> & _to) = 0;
+
+            // number of components the allocated pages can hold.
+            virtual stick::Size capacity() const = 0;
+
+            virtual stick::Size valueSize() const = 0;
+
+            // captures the storage, sharing the pages that did not change since they were last captured.
+            virtual stick::UniquePtr<SnapshotColumn> snapshot(stick::Allocator & _alloc) = 0;
+
+            // puts the storage back into the state of _column, empties it if _column is nullptr.
+            virtual void restore(const SnapshotColumn * _column) = 0;
+
+            virtual bool isTriviallyCopyable() const = 0;
+
+            // false if the components can't be cloned, snapshots don't capture those.
+            virtual bool isClonable() const = 0;
+
+            // reports all components of the storage to _observer.
+            virtual void reportAll(ComponentObserver & _observer) const = 0;
+
+            void notifySet(EntityID _id, const void * _value)
+            {
+                for (ComponentObserver * o : m_observers)
+                    o->componentSet(_id, _value);
+            }
+
+            void notifyRemoved(EntityID _id)
+            {
+                for (ComponentObserver * o : m_observers)
+                    o->componentRemoved(_id);
+            }
+
+            // tells the observers that the storage changed as a whole.
+            void notifyReset()
+            {
+                for (ComponentObserver * o : m_observers)
+                {
+                    o->componentsReset();
+                    reportAll(*o);
+                }
+            }
+
+            // hash of the packed entity ids and the bytes of the values of the page _page, see diff().
+            virtual stick::UInt64 pageHash(stick::Size _page) const = 0;
+
+            // decodes the changed pages of a delta, the storage ends up with _count components.
+            // Keeps the bits of the component _componentID in _bitsets up to date.
+            virtual void applyDelta(const DeltaPage * _pages, stick::Size _pageCount, stick::Size _count,
+                                    ComponentBitsetArray & _bitsets, stick::Size _componentID) = 0;
+
+            stick::DynamicArray<EntityID> m_entities;
+            stick::DynamicArray<stick::Size> m_sparse;
+            // owned by the hub, see Hub::addObserver()
+            stick::DynamicArray<ComponentObserver *> m_observers;
+        };
+
+        // The pages of one component storage captured by a snapshot.
+        struct SnapshotColumn
+        {
+            virtual ~SnapshotColumn()
+            {
+            }
+
+            // creates an empty storage the column can be restored into.
+            virtual stick::UniquePtr<ComponentStorage> createStorage(stick::Allocator & _alloc) const = 0;
+
+            virtual bool isTriviallyCopyable() const = 0;
+
+            // writes the pages of _current (or none if it is nullptr) that differ from _baseline
+            // (or all if it is nullptr), nothing if no page differs. One of them needs to be this.
+            virtual void writeDelta(const SnapshotColumn * _baseline, const SnapshotColumn * _current,
+                                    stick::UInt64 _hash, bool _bXorRle, DeltaWriter & _out) const = 0;
+        };
+
+        // The packed component values are stored in fixed size pages that come from a
+        // PoolAllocator, so adding components never relocates the existing ones. The pool
+        // starts with a single page and grows its chunks geometrically, so component types
+        // that only a few entities have don't reserve more than one page.
+        // Trivially copyable components are moved in bulk with memcpy when the storage
+        // is compacted or sorted. Each page remembers the copy the last snapshot or component
+        // buffer made of it, which the next one shares if the page still matches it, see
+        // Hub::snapshot() and Hub::swapBuffers().
+        template<class T>
+        struct ComponentStorageBaseT : public ComponentStorage
+        {
+            static constexpr stick::Size PageSize = ComponentPageSize;
+
+            using IsTrivial = std::integral_constant<bool, std::is_trivially_copyable<T>::value>;
+
+            // the copies of pages that snapshots and component buffers share, see SharedPage
+            using SnapshotPage = SharedPage<T>;
+
+
+            ComponentStorageBaseT(stick::Allocator & _alloc) :
+                ComponentStorage(_alloc),
+                m_pagePool(_alloc, sizeof(T) * PageSize, alignof(T)),
+                m_pages(_alloc),
+                m_snapshotPages(_alloc),
+                m_snapshotPageCount(0)
+            {
+            }
+
+            ~ComponentStorageBaseT()
+            {
+                releaseSnapshotPages();
+                if (!std::is_trivially_destructible<T>::value)
+                {
+                    for (stick::Size i = 0; i < count(); ++i)
+                        at(i).~T();
+                }
+            }
+
+            T & at(stick::Size _index)
+            {
+                return m_pages[_index / PageSize][_index % PageSize];
+            }
+
+            const T & at(stick::Size _index) const
+            {
+                return m_pages[_index / PageSize][_index % PageSize];
+            }
+
+            T * find(EntityID _id)
+            {
+                return contains(_id) ? &at(m_sparse[_id]) : nullptr;
+            }
+
+            const T * find(EntityID _id) const
+            {
+                return contains(_id) ? &at(m_sparse[_id]) : nullptr;
+            }
+
+            T & set(EntityID _id, T && _value)
+            {
+                return emplace(_id, std::move(_value));
+            }
+
+            // constructs the component in place if the entity does not have one yet,
+            // assigns it otherwise.
+            template<class...Args>
+            T & emplace(EntityID _id, Args && ..._args)
+            {
+                if (contains(_id))
+                {
+                    T & ret = at(m_sparse[_id]);
+                    detail::assignComponent(ret, std::forward<Args>(_args)...);
+                    notifySet(_id, &ret);
+                    return ret;
+                }
+
+                //grow geometrically, sets usually happen in increasing id order
+                if (_id >= m_sparse.count())
+                    resize(std::max(_id + 1, m_sparse.count() * 2));
+                stick::Size index = count();
+                ensurePage(index);
+                T * ret = detail::constructComponent<T>(&at(index), std::forward<Args>(_args)...);
+                m_entities.append(_id);
+                m_sparse[_id] = index;
+                notifySet(_id, ret);
+                return *ret;
+            }
+
+            void reserve(stick::Size _s)
+            {
+                resize(_s);
+                m_entities.reserve(_s);
+                if (_s)
+                    ensurePage(_s - 1);
+            }
+
+            void resetComponent(stick::Size _id)
+            {
+                if (!contains(_id))
+                    return;
+                notifyRemoved(_id);
+
+                //move the last component into the hole to keep the storage packed
+                stick::Size index = m_sparse[_id];
+                stick::Size last = count() - 1;
+                if (index != last)
+                {
+                    at(index) = std::move(at(last));
+                    m_entities[index] = m_entities[last];
+                    m_sparse[m_entities[index]] = index;
+                }
+                at(last).~T();
+                m_entities.removeLast();
+                m_sparse[_id] = InvalidIndex;
+            }
+
+            void swapValues(stick::Size _a, stick::Size _b)
+            {
+                using std::swap;
+                swap(at(_a), at(_b));
+            }
+
+            void moveAll(ComponentStorage & _target, const stick::DynamicArray<EntityID> & _remap)
+            {
+                moveAll(IsTrivial(), storageFor<T>(_target), _remap);
+            }
+
+            void moveAll(std::false_type, ComponentStorageBaseT & _target, const stick::DynamicArray<EntityID> & _remap)
+            {
+                for (stick::Size i = 0; i < count(); ++i)
+                {
+                    EntityID to = _remap[m_entities[i]];
+                    if (to != InvalidEntityID)
+                        _target.set(to, std::move(at(i)));
+                }
+            }
+
+            void moveAll(std::true_type, ComponentStorageBaseT & _target, const stick::DynamicArray<EntityID> & _remap)
+            {
+                //the values can only be copied in bulk if none of them is dropped and
+                //none of the entities has the component in _target already
+                bool bBulk = true;
+                for (stick::Size i = 0; bBulk && i < count(); ++i)
+                {
+                    EntityID to = _remap[m_entities[i]];
+                    bBulk = to != InvalidEntityID && !_target.contains(to);
+                }
+                if (!bBulk)
+                {
+                    moveAll(std::false_type(), _target, _remap);
+                    return;
+                }
+
+                //append behind the values _target has already
+                stick::Size n = count();
+                if (!n)
+                    return;
+                stick::Size offset = _target.count();
+                _target.ensurePage(offset + n - 1);
+                copyValues(_target, offset, *this, 0, n);
+                _target.m_entities.resize(offset + n);
+                for (stick::Size i = 0; i < n; ++i)
+                {
+                    EntityID to = _remap[m_entities[i]];
+                    if (to >= _target.m_sparse.count())
+                        _target.resize(to + 1);
+                    _target.m_entities[offset + i] = to;
+                    _target.m_sparse[to] = offset + i;
+                }
+                for (stick::Size i = 0; _target.m_observers.count() && i < n; ++i)
+                    _target.notifySet(_target.m_entities[offset + i], &_target.m_pages[(offset + i) / PageSize][(offset + i) % PageSize]);
+            }
+
+            void migrate(ComponentStorage & _target, const stick::DynamicArray<EntityID> & _from, const stick::DynamicArray<EntityID> & _to)
+            {
+                auto & target = storageFor<T>(_target);
+                for (stick::Size i = 0; i < _from.count(); ++i)
+                {
+                    if (!contains(_from[i]))
+                        continue;
+                    target.emplace(_to[i], std::move(at(m_sparse[_from[i]])));
+                    resetComponent(_from[i]);
+                }
+            }
+
+            // copies _count values starting at packed index _fromIndex of _from to _to starting
+            // at _toIndex, one memcpy per contiguous run within the pages.
+            static void copyValues(ComponentStorageBaseT & _to, stick::Size _toIndex, const ComponentStorageBaseT & _from, stick::Size _fromIndex, stick::Size _count)
+            {
+                while (_count)
+                {
+                    stick::Size n = std::min(_count, std::min(PageSize - _toIndex % PageSize, PageSize - _fromIndex % PageSize));
+                    std::memcpy(&_to.at(_toIndex), &_from.at(_fromIndex), sizeof(T) * n);
+                    _toIndex += n;
+                    _fromIndex += n;
+                    _count -= n;
+                }
+            }
+
+            stick::UniquePtr<ComponentStorage> createEmpty(stick::Allocator & _alloc) const
+            {
+                return stick::UniquePtr<ComponentStorage>(_alloc.create<ComponentStorageT<T>>(_alloc), _alloc);
+            }
+
+            stick::Size capacity() const
+            {
+                return m_pages.count() * PageSize;
+            }
+
+            stick::Size valueSize() const
+            {
+                return sizeof(T);
+            }
+
+            template<class F>
+            void sort(F _compare, stick::Allocator & _scratch)
+            {
+                stick::Size n = count();
+                stick::DynamicArray<stick::Size> order(_scratch);
+                order.resize(n);
+                for (stick::Size i = 0; i < n; ++i)
+                    order[i] = i;
+
+                //views iterate back to front, hence the packed order is the reverse of _compare
+                std::sort(order.begin(), order.end(), [&](stick::Size _a, stick::Size _b)
+                {
+                    return _compare(at(_b), at(_a));
+                });
+
+                applyOrder(IsTrivial(), order, _scratch);
+            }
+
+            // gathers the values in the new order and copies them back page wise
+            void applyOrder(std::true_type, stick::DynamicArray<stick::Size> & _order, stick::Allocator & _scratch)
+            {
+                stick::Size n = count();
+                if (!n)
+                    return;
+                stick::Block blk = _scratch.allocate(sizeof(T) * n, alignof(T));
+                T * values = reinterpret_cast<T *>(blk.ptr);
+                stick::DynamicArray<EntityID> entities(_scratch);
+                entities.resize(n);
+                for (stick::Size i = 0; i < n; ++i)
+                {
+                    std::memcpy(&values[i], &at(_order[i]), sizeof(T));
+                    entities[i] = m_entities[_order[i]];
+                }
+                for (stick::Size p = 0; p * PageSize < n; ++p)
+                {
+                    stick::Size c = std::min(PageSize, n - p * PageSize);
+                    std::memcpy(m_pages[p], values + p * PageSize, sizeof(T) * c);
+                }
+                _scratch.deallocate(blk);
+
+                for (stick::Size i = 0; i < n; ++i)
+                {
+                    m_entities[i] = entities[i];
+                    m_sparse[m_entities[i]] = i;
+                }
+            }
+
+            void applyOrder(std::false_type, stick::DynamicArray<stick::Size> & _order, stick::Allocator &)
+            {
+                stick::Size n = count();
+                //apply the permutation by following its cycles, moving every component once
+                for (stick::Size i = 0; i < n; ++i)
+                {
+                    if (_order[i] == i || _order[i] == InvalidIndex)
+                        continue;
+
+                    T tmp = std::move(at(i));
+                    EntityID tmpEntity = m_entities[i];
+                    stick::Size j = i;
+                    while (true)
+                    {
+                        stick::Size k = _order[j];
+                        _order[j] = InvalidIndex;
+                        if (k == i)
+                        {
+                            at(j) = std::move(tmp);
+                            m_entities[j] = tmpEntity;
+                            break;
+                        }
+                        at(j) = std::move(at(k));
+                        m_entities[j] = m_entities[k];
+                        j = k;
+                    }
+                }
+
+                for (stick::Size i = 0; i < n; ++i)
+                    m_sparse[m_entities[i]] = i;
+            }
+
+            void ensurePage(stick::Size _index)
+            {
+                stick::Size pi = _index / PageSize;
+                while (m_pages.count() <= pi)
+                {
+                    m_pages.append(reinterpret_cast<T *>(m_pagePool.allocate(sizeof(T) * PageSize, alignof(T)).ptr));
+                }
+            }
+
+            stick::UniquePtr<SnapshotColumn> snapshot(stick::Allocator & _alloc)
+            {
+                auto * column = _alloc.create<SnapshotColumnT<T>>(_alloc);
+                sharePages(column->pages, _alloc);
+                column->count = count();
+                column->sparseCount = m_sparse.count();
+                return stick::UniquePtr<SnapshotColumn>(column, _alloc);
+            }
+
+            void restore(const SnapshotColumn * _column)
+            {
+                auto * column = static_cast<const SnapshotColumnT<T> *>(_column);
+                stick::Size n = count();
+                stick::Size pageCount = (n + PageSize - 1) / PageSize;
+                stick::Size columnPageCount = column ? column->pages.count() : 0;
+
+                //drop the pages that differ from the snapshot, the others are left alone
+                for (stick::Size p = pageCount; p < m_snapshotPages.count(); ++p)
+                    touchPage(p);
+                for (stick::Size p = 0; p < pageCount; ++p)
+                {
+                    if (p < columnPageCount && m_snapshotPages.count() > p && m_snapshotPages[p] == column->pages[p] &&
+                            matchesCopy(p, *column->pages[p]))
+                        continue;
+                    stick::Size end = std::min(n, (p + 1) * PageSize);
+                    for (stick::Size i = p * PageSize; i < end; ++i)
+                    {
+                        m_sparse[m_entities[i]] = InvalidIndex;
+                        if (!std::is_trivially_destructible<T>::value)
+                            m_pages[p][i % PageSize].~T();
+                    }
+                    touchPage(p);
+                }
+
+                if (!column)
+                {
+                    m_entities.clear();
+                    return;
+                }
+
+                resize(column->sparseCount);
+                m_entities.resize(column->count);
+                if (column->count)
+                    ensurePage(column->count - 1);
+                while (m_snapshotPages.count() < columnPageCount)
+                    m_snapshotPages.append(nullptr);
+                for (stick::Size p = 0; p < columnPageCount; ++p)
+                {
+                    SnapshotPage * page = column->pages[p];
+                    if (m_snapshotPages[p] == page)
+                        continue;
+                    cloneValues(m_pages[p], page->values(), page->count);
+                    std::memcpy(&m_entities[p * PageSize], page->entities, sizeof(EntityID) * page->count);
+                    for (stick::Size i = 0; i < page->count; ++i)
+                        m_sparse[page->entities[i]] = p * PageSize + i;
+                    ++page->refs;
+                    m_snapshotPages[p] = page;
+                    ++m_snapshotPageCount;
+                }
+            }
+
+            bool isTriviallyCopyable() const
+            {
+                return IsTrivial::value;
+            }
+
+            bool isClonable() const
+            {
+                return CloneTrait<T>::IsClonable;
+            }
+
+            void reportAll(ComponentObserver & _observer) const
+            {
+                for (stick::Size i = 0; i < count(); ++i)
+                    _observer.componentSet(m_entities[i], &at(i));
+            }
+
+            stick::UInt64 pageHash(stick::Size _page) const
+            {
+                stick::Size first = _page * PageSize;
+                stick::Size c = first < count() ? std::min(PageSize, count() - first) : 0;
+                if (!c)
+                    return pageHash(nullptr, nullptr, 0);
+                return pageHash(&m_entities[first], m_pages[_page], c);
+            }
+
+            static stick::UInt64 pageHash(const EntityID * _entities, const T * _values, stick::Size _count)
+            {
+                stick::UInt64 ret = hashBytes(_entities, sizeof(EntityID) * _count, detail::FNVOffsetBasis);
+                return hashBytes(_values, sizeof(T) * _count, ret);
+            }
+
+            void applyDelta(const DeltaPage * _pages, stick::Size _pageCount, stick::Size _count,
+                            ComponentBitsetArray & _bitsets, stick::Size _componentID)
+            {
+                //the hub only hands deltas to trivially copyable storages
+                STICK_ASSERT(IsTrivial::value);
+                stick::Size n = count();
+                stick::Size pageCount = (n + PageSize - 1) / PageSize;
+                stick::Size newPageCount = (_count + PageSize - 1) / PageSize;
+
+                //forget the entities of the pages that change or go away
+                stick::Size pi = 0;
+                for (stick::Size p = 0; p < pageCount; ++p)
+                {
+                    while (pi < _pageCount && _pages[pi].index < p)
+                        ++pi;
+                    if (p < newPageCount && (pi == _pageCount || _pages[pi].index != p))
+                        continue;
+                    stick::Size end = std::min(n, (p + 1) * PageSize);
+                    for (stick::Size i = p * PageSize; i < end; ++i)
+                    {
+                        m_sparse[m_entities[i]] = InvalidIndex;
+                        _bitsets[m_entities[i]][_componentID] = false;
+                    }
+                    touchPage(p);
+                }
+
+                //the pages are decoded in place, XORed with what they hold now
+                m_entities.resize(_count);
+                if (_count)
+                    ensurePage(_count - 1);
+                for (pi = 0; pi < _pageCount; ++pi)
+                {
+                    const DeltaPage & page = _pages[pi];
+                    stick::Size first = page.index * PageSize;
+                    stick::Size c = std::min(PageSize, _count - first);
+                    stick::Size oldC = first < n ? std::min(PageSize, n - first) : 0;
+                    EntityID * entities = &m_entities[first];
+                    DeltaReader er = page.entities;
+                    DeltaReader vr = page.values;
+                    if (page.bXorRle)
+                    {
+                        er.readXorRle(entities, sizeof(EntityID) * c, entities, sizeof(EntityID) * oldC);
+                        vr.readXorRle(m_pages[page.index], sizeof(T) * c, m_pages[page.index], sizeof(T) * oldC);
+                    }
+                    else
+                    {
+                        er.readBytes(entities, sizeof(EntityID) * c);
+                        vr.readBytes(m_pages[page.index], sizeof(T) * c);
+                    }
+                    for (stick::Size i = 0; i < c; ++i)
+                    {
+                        //Hub::applyDelta() range checked the ids before changing anything
+                        STICK_ASSERT(entities[i] < m_sparse.count() && entities[i] < _bitsets.count());
+                        m_sparse[entities[i]] = first + i;
+                        _bitsets[entities[i]][_componentID] = true;
+                    }
+                }
+            }
+
+            // appends a shared copy of every page to _out, taking a reference to each. Only the
+            // pages that changed since they were last shared are copied.
+            void sharePages(stick::DynamicArray<SnapshotPage *> & _out, stick::Allocator & _alloc)
+            {
+                stick::Size pageCount = (count() + PageSize - 1) / PageSize;
+                while (m_snapshotPages.count() < pageCount)
+                    m_snapshotPages.append(nullptr);
+                _out.reserve(_out.count() + pageCount);
+                for (stick::Size p = 0; p < pageCount; ++p)
+                {
+                    if (m_snapshotPages[p] && !matchesCopy(p, *m_snapshotPages[p]))
+                        touchPage(p);
+                    if (!m_snapshotPages[p])
+                    {
+                        m_snapshotPages[p] = copyPage(p, _alloc);
+                        ++m_snapshotPageCount;
+                    }
+                    ++m_snapshotPages[p]->refs;
+                    _out.append(m_snapshotPages[p]);
+                }
+                //the storage shrank since these were copied
+                for (stick::Size p = pageCount; p < m_snapshotPages.count(); ++p)
+                    touchPage(p);
+            }
+
+            SnapshotPage * copyPage(stick::Size _page, stick::Allocator & _alloc) const
+            {
+                SnapshotPage * ret = _alloc.create<SnapshotPage>();
+                ret->allocator = &_alloc;
+                //the reference of the storage
+                ret->refs = 1;
+                ret->count = std::min(PageSize, count() - _page * PageSize);
+                std::memcpy(ret->entities, &m_entities[_page * PageSize], sizeof(EntityID) * ret->count);
+                cloneValues(ret->values(), m_pages[_page], ret->count);
+                return ret;
+            }
+
+            // constructs copies of _count values of _from in the uninitialized memory _to.
+            static void cloneValues(T * _to, const T * _from, stick::Size _count)
+            {
+                cloneValues(IsTrivial(), std::integral_constant<bool, CloneTrait<T>::IsClonable>(), _to, _from, _count);
+            }
+
+            template<class C>
+            static void cloneValues(std::true_type, C, T * _to, const T * _from, stick::Size _count)
+            {
+                std::memcpy(_to, _from, sizeof(T) * _count);
+            }
+
+            static void cloneValues(std::false_type, std::true_type, T * _to, const T * _from, stick::Size _count)
+            {
+                for (stick::Size i = 0; i < _count; ++i)
+                    new (&_to[i]) T(CloneTrait<T>::clone(_from[i]));
+            }
+
+            static void cloneValues(std::false_type, std::false_type, T *, const T *, stick::Size _count)
+            {
+                //components that can't be cloned can't be captured by snapshots
+                STICK_ASSERT(!_count);
+            }
+
+            // true if the page _page still holds what _copy holds.
+            bool matchesCopy(stick::Size _page, const SnapshotPage & _copy) const
+            {
+                stick::Size first = _page * PageSize;
+                stick::Size c = first < count() ? std::min(PageSize, count() - first) : 0;
+                if (_copy.count != c)
+                    return false;
+                return !c || (!std::memcmp(_copy.entities, &m_entities[first], sizeof(EntityID) * c) &&
+                              equalValues(_copy.values(), m_pages[_page], c));
+            }
+
+            static bool equalValues(const T * _a, const T * _b, stick::Size _count)
+            {
+                return equalValues(IsTrivial(), detail::IsEqualityComparable<T>(), _a, _b, _count);
+            }
+
+            template<class E>
+            static bool equalValues(std::true_type, E, const T * _a, const T * _b, stick::Size _count)
+            {
+                return !std::memcmp(_a, _b, sizeof(T) * _count);
+            }
+
+            static bool equalValues(std::false_type, std::true_type, const T * _a, const T * _b, stick::Size _count)
+            {
+                for (stick::Size i = 0; i < _count; ++i)
+                {
+                    if (!(_a[i] == _b[i]))
+                        return false;
+                }
+                return true;
+            }
+
+            static bool equalValues(std::false_type, std::false_type, const T *, const T *, stick::Size)
+            {
+                //can't tell, so the page is copied again
+                return false;
+            }
+
+            // forgets the snapshot copy of the page _page.
+            void touchPage(stick::Size _page)
+            {
+                if (_page < m_snapshotPages.count() && m_snapshotPages[_page])
+                {
+                    SnapshotPage::release(m_snapshotPages[_page]);
+                    m_snapshotPages[_page] = nullptr;
+                    --m_snapshotPageCount;
+                }
+            }
+
+            void releaseSnapshotPages()
+            {
+                for (stick::Size p = 0; m_snapshotPageCount && p < m_snapshotPages.count(); ++p)
+                    touchPage(p);
+            }
+
+            PoolAllocator m_pagePool;
+            stick::DynamicArray<T *> m_pages;
+            // the copy of each page the snapshots share as long as the page is unchanged, nullptr otherwise
+            stick::DynamicArray<SnapshotPage *> m_snapshotPages;
+            stick::Size m_snapshotPageCount;
+        };
+
+        template<class T>
+        struct ComponentStorageT : public ComponentStorageBaseT<T>
+        {
+            using ComponentStorageBaseT<T>::ComponentStorageBaseT;
+
+            bool cloneComponent(stick::Size _from, stick::Size _to)
+            {
+                return cloneComponent(std::integral_constant<bool, CloneTrait<T>::IsClonable>(), _from, _to);
+            }
+
+        private:
+
+            bool cloneComponent(std::true_type, stick::Size _from, stick::Size _to)
+            {
+                //pages never move, so from stays valid while the clone is added
+                const T * from = this->find(_from);
+                if (!from)
+                    return false;
+                this->emplace(_to, CloneTrait<T>::clone(*from));
+                return true;
+            }
+
+            bool cloneComponent(std::false_type, stick::Size, stick::Size)
+            {
+                return false;
+            }
+        };
+
+        template<class T>
+        struct SnapshotColumnT : public SnapshotColumn
+        {
+            using Page = typename ComponentStorageBaseT<T>::SnapshotPage;
+
+            SnapshotColumnT(stick::Allocator & _alloc) :
+                pages(_alloc),
+                count(0),
+                sparseCount(0)
+            {
+            }
+
+            ~SnapshotColumnT()
+            {
+                for (Page * page : pages)
+                    Page::release(page);
+            }
+
+            stick::UniquePtr<ComponentStorage> createStorage(stick::Allocator & _alloc) const
+            {
+                return Hub::createStorage<T>(_alloc);
+            }
+
+            bool isTriviallyCopyable() const
+            {
+                return ComponentStorageBaseT<T>::IsTrivial::value;
+            }
+
+            void writeDelta(const SnapshotColumn * _baseline, const SnapshotColumn * _current,
+                            stick::UInt64 _hash, bool _bXorRle, DeltaWriter & _out) const
+            {
+                auto * baseline = static_cast<const SnapshotColumnT *>(_baseline);
+                auto * current = static_cast<const SnapshotColumnT *>(_current);
+                stick::Size count = current ? current->count : 0;
+                stick::Size pageCount = current ? current->pages.count() : 0;
+
+                //pages the snapshots share did not change, the others are compared
+                auto baselinePage = [&](stick::Size _index) -> const Page *
+                {
+                    return baseline && _index < baseline->pages.count() ? baseline->pages[_index] : nullptr;
+                };
+                auto isChanged = [&](stick::Size _index)
+                {
+                    const Page * page = current->pages[_index];
+                    const Page * base = baselinePage(_index);
+                    if (page == base)
+                        return false;
+                    return !base || base->count != page->count ||
+                           std::memcmp(base->entities, page->entities, sizeof(EntityID) * page->count) ||
+                           std::memcmp(base->values(), page->values(), sizeof(T) * page->count);
+                };
+
+                stick::Size changed = 0;
+                for (stick::Size p = 0; p < pageCount; ++p)
+                    changed += isChanged(p);
+                if (!changed && count == (baseline ? baseline->count : 0))
+                    return;
+
+                _out.writeUInt8(1);
+                _out.writeUInt64(_hash);
+                _out.writeVarint(sizeof(T));
+                _out.writeVarint(ComponentStorageBaseT<T>::PageSize);
+                _out.writeVarint(count);
+                _out.writeVarint(changed);
+                for (stick::Size p = 0; p < pageCount; ++p)
+                {
+                    if (!isChanged(p))
+                        continue;
+                    const Page * page = current->pages[p];
+                    const Page * base = baselinePage(p);
+                    stick::Size baseCount = base ? base->count : 0;
+                    _out.writeVarint(p);
+                    //lets the receiver check that it has the baseline of the page
+                    _out.writeUInt64(base ? ComponentStorageBaseT<T>::pageHash(base->entities, base->values(), baseCount) :
+                                     ComponentStorageBaseT<T>::pageHash(nullptr, nullptr, 0));
+                    _out.writeUInt8(_bXorRle);
+                    if (_bXorRle)
+                    {
+                        _out.writeXorRle(page->entities, sizeof(EntityID) * page->count,
+                                         base ? base->entities : nullptr, sizeof(EntityID) * baseCount);
+                        _out.writeXorRle(page->values(), sizeof(T) * page->count,
+                                         base ? base->values() : nullptr, sizeof(T) * baseCount);
+                    }
+                    else
+                    {
+                        _out.writeBytes(page->entities, sizeof(EntityID) * page->count);
+                        _out.writeBytes(page->values(), sizeof(T) * page->count);
+                    }
+                }
+            }
+
+            stick::DynamicArray<Page *> pages;
+            stick::Size count;
+            stick::Size sparseCount;
+        };
+
+        // returns the storage for T, creates it if needed
+        template<class T>
+        ComponentStorage & ensureStorage()
+        {
+            static_assert(!T::IsTag, "tags don't have a storage");
+            using ValueType = typename T::ValueType;
+            stick::Size cid = componentID<T>();
+
+            if (m_componentStorage.count() <= cid)
+            {
+                m_componentStorage.resize(cid + 1);
+            }
+            auto & storage = m_componentStorage[cid];
+            if (!storage)
+            {
+                createStorageForComponentID<ValueType>(cid, m_nextEntityID);
+            }
+            return *storage;
+        }
+
+        ComponentStorage * storage(stick::Size _componentID)
+        {
+            return _componentID < m_componentStorage.count() ? m_componentStorage[_componentID].get() : nullptr;
+        }
+
+        const ComponentStorage * storage(stick::Size _componentID) const
+        {
+            return _componentID < m_componentStorage.count() ? m_componentStorage[_componentID].get() : nullptr;
+        }
+
+        template<class T>
+        static ComponentStorageBaseT<T> & storageFor(ComponentStorage & _storage)
+        {
+            return static_cast<ComponentStorageBaseT<T> &>(_storage);
+        }
+
+        template<class T>
+        static const ComponentStorageBaseT<T> & storageFor(const ComponentStorage & _storage)
+        {
+            return static_cast<const ComponentStorageBaseT<T> &>(_storage);
+        }
+
+        stick::Allocator * m_alloc;
+        stick::UniquePtr<PagedArena> m_arena;
+        stick::DynamicArray<stick::UniquePtr<ComponentStorage>> m_componentStorage;
+        ComponentBitsetArray m_componentBitsets;
+        FreeList m_freeList;
+        // see sortedFreeList(), lives in m_alloc as it outlives clear() and compact()
+        mutable FreeList m_sortedFreeList;
+        mutable std::atomic<bool> m_bSortedFreeListValid;
+        mutable std::mutex m_sortedFreeListMutex;
+        HandleVersionArray m_handleVersions;
+        EntityTypeArray m_entityTypes;
+        EntityID m_nextEntityID;
+        // handle version new entities start with. Bumped by clear() so that
+        // handles from before the clear never become valid again.
+        stick::Size m_versionBase;
+        stick::Size m_maxVersion;
+        struct AtomicCounters
+        {
+            std::atomic<stick::Size> createdEntities{0};
+            std::atomic<stick::Size> destroyedEntities{0};
+            std::atomic<stick::Size> setComponents{0};
+            std::atomic<stick::Size> removedComponents{0};
+            std::atomic<stick::Size> viewIterations{0};
+        };
+        // atomic as views can be iterated from several systems at once
+        mutable AtomicCounters m_counters;
+        bool m_bHierarchyUsed;
+        bool m_bHierarchyDirty;
+        // lives in m_alloc rather than the arena as it is filled from other threads
+        DestroyQueue m_destroyQueue;
+        // indexed by component id, live in m_alloc as they outlive clear() and compact()
+        stick::DynamicArray<stick::UniquePtr<ComponentBufferBase>> m_componentBuffers;
+        struct SingletonBase
+        {
+            virtual ~SingletonBase()
+            {
+            }
+        };
+        template<class T>
+        struct SingletonT : public SingletonBase
+        {
+            // constructed like a component, so aggregates can be set from their fields
+            template<class...Args>
+            SingletonT(Args && ..._args)
+            {
+                detail::constructComponent<T>(&storage, std::forward<Args>(_args)...);
+            }
+
+            ~SingletonT()
+            {
+                value().~T();
+            }
+
+            T & value()
+            {
+                return *reinterpret_cast<T *>(&storage);
+            }
+
+            const T & value() const
+            {
+                return *reinterpret_cast<const T *>(&storage);
+            }
+
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        };
+        // indexed by component id, in m_alloc
+        stick::DynamicArray<stick::UniquePtr<SingletonBase>> m_singletons;
+        struct ObserverEntry
+        {
+            stick::Size componentID;
+            stick::UniquePtr<ComponentObserver> observer;
+        };
+        // live in m_alloc, too
+        stick::DynamicArray<ObserverEntry> m_observers;
+        // indexed by component id, owned by m_observers
+        stick::DynamicArray<SpatialIndex *> m_spatialIndices;
+        stick::DynamicArray<ComponentIndexBase *> m_indices;
+        stick::Size m_bufferGeneration;
+        mutable std::mutex m_destroyQueueMutex;
+    };
+
+    // Snapshots share pages with the hubs they were taken from and restored into without
+    // any locking, so they need to be used on the thread that owns those hubs. They can
+    // outlive the hub, but not its allocator.
+    class STICK_API Hub::Snapshot
+    {
+        friend class Hub;
+
+    public:
+
+        // an empty snapshot, restoring it destroys all entities.
+        Snapshot(stick::Allocator & _alloc = stick::defaultAllocator());
+
+        Snapshot(Snapshot && _other) = default;
+
+        Snapshot & operator = (Snapshot && _other) = default;
+
+        stick::Size entityCount() const;
+
+    private:
+
+        stick::DynamicArray<stick::UniquePtr<SnapshotColumn>> m_columns;
+        ComponentBitsetArray m_componentBitsets;
+        HandleVersionArray m_handleVersions;
+        EntityTypeArray m_entityTypes;
+        FreeList m_freeList;
+        EntityID m_nextEntityID;
+        stick::Size m_maxVersion;
+        bool m_bHierarchyUsed;
+    };
+
+    // Consecutive packed components of the lead component of a view (its first component
+    // that is not a tag), see TypedEntityRange::chunks(). The entity ids and the values of
+    // the lead component are plain arrays, so kernels can run over them directly. The lead
+    // storage also holds entities that lack other components of the view, matches() tells
+    // them apart.
+    template<class...C>
+    class Hub::Chunk
+    {
+    public:
+
+        using Lead = typename detail::FirstStored<C...>::Type;
+        using LeadValueType = typename Lead::ValueType;
+
+
+        Chunk(Hub * _hub, const EntityID * _entities, LeadValueType * _values, stick::Size _count, const ComponentBitset & _mask) :
+            m_hub(_hub),
+            m_entities(_entities),
+            m_values(_values),
+            m_count(_count),
+            m_mask(_mask)
+        {
+        }
+
+        stick::Size count() const
+        {
+            return m_count;
+        }
+
+        const EntityID * entities() const
+        {
+            return m_entities;
+        }
+
+        LeadValueType * values() const
         {
-            return componentID<C>() == _componentID;
+            return m_values;
         }
 
-        template <class C1, class C2, class ... Components>
-        bool contains(stick::Size _componentID) const
+        // true if the entity at _index has all components of the view.
+        bool matches(stick::Size _index) const
         {
-            return contains<C1>(_componentID) || contains<C2, Components ...>(_componentID);
+            return (m_hub->m_componentBitsets[m_entities[_index]] & m_mask) == m_mask;
         }
 
-        Entity clone(EntityID _id);
+        Entity entity(stick::Size _index) const;
 
-        template<class ... Components>
-        Entity cloneWithout(EntityID _id);
+        // the component T of the entity at _index, which needs to have it.
+        template<class T>
+        typename T::ValueType & get(stick::Size _index) const
+        {
+            return m_hub->component<T>(m_entities[_index]).value();
+        }
 
-        template<class ... Components>
-        Entity cloneWith(EntityID _id);
+    private:
 
-        void cloneComponents(EntityID _from, EntityID _to);
+        Hub * m_hub;
+        const EntityID * m_entities;
+        LeadValueType * m_values;
+        stick::Size m_count;
+        ComponentBitset m_mask;
+    };
 
-        template<class ... Components>
-        void cloneComponents(EntityID _from, EntityID _to);
+    // Random access range of the chunks of a view. Chunks never cross a storage page, so
+    // a _chunkSize larger than the page size yields one chunk per page. The range captures
+    // the number of components when it is created, the hub must not be changed structurally
+    // while it is in use. Different chunks can be written from different threads.
+    template<class...C>
+    class Hub::ChunkRange
+    {
+    public:
 
-        template<class ... Components>
-        void cloneComponentsWithout(EntityID _from, EntityID _to);
+        static_assert(!std::is_void<typename detail::FirstStored<C...>::Type>::value, "chunks need a component that is not a tag");
 
-        template<class T>
-        stick::Size componentID() const
-        {
-            //TODO: find a solution that does not rely on
-            //static to make sure component ids are hub specific
-            //and thread safe.
-            static stick::Size id = s_nextComponentID++;
-            return id;
-        }
+        using ChunkType = Chunk<C...>;
+        using Lead = typename ChunkType::Lead;
+        using LeadValueType = typename ChunkType::LeadValueType;
 
-        template <class C>
-        ComponentBitset componentMask() const
+        class Iter
         {
-            ComponentBitset mask;
-            mask.set(componentID<C>());
-            return mask;
-        }
+        public:
 
-        template <class C1, class C2, class ... Components>
-        ComponentBitset componentMask() const
-        {
-            return componentMask<C1>() | componentMask<C2, Components ...>();
-        }
+            typedef std::random_access_iterator_tag iterator_category;
+            typedef ChunkType value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef void pointer;
+            typedef ChunkType reference;
 
-        struct ComponentStorage
-        {
-            ComponentStorage(void * _array) :
-                arrayPtr(_array)
-            {
 
+            Iter(const ChunkRange * _range = nullptr, stick::Size _index = 0) :
+                m_range(_range),
+                m_index(_index)
+            {
             }
 
-            virtual ~ComponentStorage()
+            ChunkType operator * () const
             {
+                return (*m_range)[m_index];
             }
 
-            template<class T>
-            stick::DynamicArray<stick::Maybe<T>> & componentArray()
+            ChunkType operator [] (difference_type _offset) const
             {
-                return *reinterpret_cast<stick::DynamicArray<stick::Maybe<T>>*>(arrayPtr);
+                return (*m_range)[m_index + _offset];
             }
 
-            virtual void cloneComponent(stick::Size _from, stick::Size _to) = 0;
-
-            virtual void resize(stick::Size _s) = 0;
-
-            virtual void resetComponent(stick::Size _index) = 0;
-
-            void * arrayPtr;
-        };
-
-        template<class T>
-        struct IsCopyConstructible
-        {
-            static constexpr bool Value = std::is_copy_constructible<T>::value;
-        };
+            Iter & operator ++ ()
+            {
+                ++m_index;
+                return *this;
+            }
 
-        template<class T>
-        struct IsCopyConstructible<stick::DynamicArray<T> >
-        {
-            static constexpr bool Value = std::is_copy_constructible<T>::value;
-        };
+            Iter operator ++ (int)
+            {
+                Iter ret = *this;
+                ++m_index;
+                return ret;
+            }
 
-        template<class T, class Enable = void>
-        struct ComponentStorageT : public ComponentStorage
-        {
-            typedef stick::Maybe<T> MaybeType;
-            typedef stick::DynamicArray<MaybeType> DynamicArrayType;
+            Iter & operator -- ()
+            {
+                --m_index;
+                return *this;
+            }
 
-            ComponentStorageT(stick::Allocator & _alloc) :
-                ComponentStorage(_alloc.create<DynamicArrayType>(_alloc)),
-                m_alloc(&_alloc)
+            Iter operator -- (int)
             {
+                Iter ret = *this;
+                --m_index;
+                return ret;
             }
 
-            ~ComponentStorageT()
+            Iter & operator += (difference_type _offset)
             {
-                m_alloc->destroy(&componentArray<T>());
+                m_index += _offset;
+                return *this;
             }
 
-            void cloneComponent(stick::Size _from, stick::Size _to)
+            Iter & operator -= (difference_type _offset)
             {
-                auto & ca = componentArray<T>();
-                if (ca[_from])
-                {
-                    ca[_to] = *ca[_from];
-                }
+                m_index -= _offset;
+                return *this;
             }
 
-            void resize(stick::Size _s)
+            Iter operator + (difference_type _offset) const
             {
-                componentArray<T>().resize(_s);
+                return Iter(m_range, m_index + _offset);
             }
 
-            void resetComponent(stick::Size _index)
+            Iter operator - (difference_type _offset) const
             {
-                // reset the mabye!
-                STICK_ASSERT(_index < componentArray<T>().count());
-                componentArray<T>()[_index].reset();
+                return Iter(m_range, m_index - _offset);
             }
 
-            stick::Allocator * m_alloc;
-        };
+            difference_type operator - (const Iter & _other) const
+            {
+                return static_cast<difference_type>(m_index) - static_cast<difference_type>(_other.m_index);
+            }
 
-        template<class T>
-        struct ComponentStorageT < T, typename std::enable_if < !IsCopyConstructible<T>::Value >::type > : public ComponentStorage
-        {
-            typedef stick::Maybe<T> MaybeType;
-            typedef stick::DynamicArray<MaybeType> DynamicArrayType;
+            bool operator == (const Iter & _other) const
+            {
+                return m_index == _other.m_index;
+            }
 
-            ComponentStorageT(stick::Allocator & _alloc) :
-                ComponentStorage(_alloc.create<DynamicArrayType>(_alloc)),
-                m_alloc(&_alloc)
+            bool operator != (const Iter & _other) const
             {
+                return m_index != _other.m_index;
             }
 
-            ~ComponentStorageT()
+            bool operator < (const Iter & _other) const
             {
-                m_alloc->destroy(&componentArray<T>());
+                return m_index < _other.m_index;
             }
 
-            //@TODO: BIG N FAT
-            void cloneComponent(stick::Size _from, stick::Size _to)
+            bool operator > (const Iter & _other) const
             {
-                //Warning? Fail?
+                return m_index > _other.m_index;
             }
 
-            void resize(stick::Size _s)
+            bool operator <= (const Iter & _other) const
             {
-                componentArray<T>().resize(_s);
+                return m_index <= _other.m_index;
             }
 
-            void resetComponent(stick::Size _index)
+            bool operator >= (const Iter & _other) const
             {
-                // reset the mabye!
-                STICK_ASSERT(_index < componentArray<T>().count());
-                componentArray<T>()[_index].reset();
+                return m_index >= _other.m_index;
             }
 
-            stick::Allocator * m_alloc;
+        private:
+
+            const ChunkRange * m_range;
+            stick::Size m_index;
         };
 
-        stick::Allocator * m_alloc;
-        stick::DynamicArray<stick::UniquePtr<ComponentStorage>> m_componentStorage;
-        ComponentBitsetArray m_componentBitsets;
-        FreeList m_freeList;
-        HandleVersionArray m_handleVersions;
-        EntityID m_nextEntityID;
-        static stick::Size s_nextComponentID;
+
+        ChunkRange(Hub * _hub, stick::Size _chunkSize) :
+            m_hub(_hub),
+            m_storage(nullptr),
+            m_count(0),
+            m_chunkSize(std::min(std::max(_chunkSize, (stick::Size)1), PageSize)),
+            m_chunksPerPage((PageSize + m_chunkSize - 1) / m_chunkSize),
+            m_mask(_hub->template componentMask<C...>())
+        {
+            ComponentStorage * s = _hub->storage(_hub->template componentID<Lead>());
+            if (!s)
+                return;
+            m_storage = &storageFor<LeadValueType>(*s);
+            m_count = s->count();
+        }
+
+        // number of chunks
+        stick::Size count() const
+        {
+            stick::Size fullPages = m_count / PageSize;
+            return fullPages * m_chunksPerPage + (m_count % PageSize + m_chunkSize - 1) / m_chunkSize;
+        }
+
+        ChunkType operator [] (stick::Size _index) const
+        {
+            STICK_ASSERT(_index < count());
+            stick::Size page = _index / m_chunksPerPage;
+            stick::Size begin = page * PageSize + (_index % m_chunksPerPage) * m_chunkSize;
+            stick::Size end = std::min(std::min(begin + m_chunkSize, (page + 1) * PageSize), m_count);
+            return ChunkType(m_hub, &m_storage->entities()[begin], &m_storage->at(begin), end - begin, m_mask);
+        }
+
+        Iter begin() const
+        {
+            return Iter(this, 0);
+        }
+
+        Iter end() const
+        {
+            return Iter(this, count());
+        }
+
+    private:
+
+        static constexpr stick::Size PageSize = ComponentStorageBaseT<LeadValueType>::PageSize;
+
+        Hub * m_hub;
+        ComponentStorageBaseT<LeadValueType> * m_storage;
+        stick::Size m_count;
+        stick::Size m_chunkSize;
+        stick::Size m_chunksPerPage;
+        ComponentBitset m_mask;
     };
 }
 
@@ -484,145 +2352,499 @@ namespace brick
 
 namespace brick
 {
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A>::EntityIterator() :
+    template<class T>
+    constexpr stick::Size Hub::ComponentStorageBaseT<T>::PageSize;
+
+    template<class...C>
+    constexpr stick::Size Hub::ChunkRange<C...>::PageSize;
+
+    template<class...C>
+    Entity Hub::Chunk<C...>::entity(stick::Size _index) const
+    {
+        return m_hub->entityForID(m_entities[_index]);
+    }
+
+    template<bool IC>
+    Hub::EntityIterator<IC>::EntityIterator() :
         m_hub(nullptr),
+        m_freeList(nullptr),
         m_current(-1),
         m_freeListIndex(-1)
     {
     }
 
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A>::EntityIterator(HubPtr _hub, stick::Size _current, const ComponentBitset & _mask) :
+    template<bool IC>
+    Hub::EntityIterator<IC>::EntityIterator(HubPtr _hub, stick::Size _current) :
         m_hub(_hub),
+        m_freeList(&_hub->sortedFreeList()),
         m_current(_current),
-        m_freeListIndex(0),
-        m_mask(_mask),
-        m_freeListAccessor(_hub)
+        m_freeListIndex(0)
     {
-        std::sort(m_freeListAccessor.freeList().begin(), m_freeListAccessor.freeList().end());
+        stick::Size below = std::lower_bound(m_freeList->begin(), m_freeList->end(), _current) - m_freeList->begin();
+        moveToRank(std::min(_current, (stick::Size)m_hub->m_nextEntityID) - below);
     }
 
-    template<bool IC, bool A>
-    bool Hub::EntityIterator<IC, A>::operator == (const EntityIterator & _other) const
+    template<bool IC>
+    bool Hub::EntityIterator<IC>::operator == (const EntityIterator & _other) const
     {
         return m_current == _other.m_current;
     }
 
-    template<bool IC, bool A>
-    bool Hub::EntityIterator<IC, A>::operator != (const EntityIterator & _other) const
+    template<bool IC>
+    bool Hub::EntityIterator<IC>::operator != (const EntityIterator & _other) const
     {
         return m_current != _other.m_current;
     }
 
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A> & Hub::EntityIterator<IC, A>::operator--()
+    template<bool IC>
+    bool Hub::EntityIterator<IC>::operator < (const EntityIterator & _other) const
+    {
+        return m_current < _other.m_current;
+    }
+
+    template<bool IC>
+    bool Hub::EntityIterator<IC>::operator > (const EntityIterator & _other) const
+    {
+        return m_current > _other.m_current;
+    }
+
+    template<bool IC>
+    bool Hub::EntityIterator<IC>::operator <= (const EntityIterator & _other) const
+    {
+        return m_current <= _other.m_current;
+    }
+
+    template<bool IC>
+    bool Hub::EntityIterator<IC>::operator >= (const EntityIterator & _other) const
+    {
+        return m_current >= _other.m_current;
+    }
+
+    template<bool IC>
+    Hub::EntityIterator<IC> & Hub::EntityIterator<IC>::operator--()
     {
         decrement();
         return *this;
     }
 
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A> Hub::EntityIterator<IC, A>::operator--(int)
+    template<bool IC>
+    Hub::EntityIterator<IC> Hub::EntityIterator<IC>::operator--(int)
     {
         EntityIterator ret = *this;
         decrement();
         return ret;
     }
 
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A> & Hub::EntityIterator<IC, A>::operator-=(stick::Size _i)
+    template<bool IC>
+    Hub::EntityIterator<IC> & Hub::EntityIterator<IC>::operator-=(stick::Size _i)
     {
-        for (stick::Size i = 0; i <= _i; ++i)
-            decrement();
+        STICK_ASSERT(_i <= rank());
+        moveToRank(rank() - _i);
         return *this;
     }
 
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A> Hub::EntityIterator<IC, A>::operator-(stick::Size _i) const
+    template<bool IC>
+    Hub::EntityIterator<IC> Hub::EntityIterator<IC>::operator-(stick::Size _i) const
     {
         EntityIterator ret = *this;
-        for (stick::Size i = 0; i <= _i; ++i)
-            ret.decrement();
+        ret -= _i;
         return ret;
     }
 
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A> & Hub::EntityIterator<IC, A>::operator++()
+    template<bool IC>
+    Hub::EntityIterator<IC> & Hub::EntityIterator<IC>::operator++()
     {
         increment();
         return *this;
     }
 
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A> Hub::EntityIterator<IC, A>::operator++(int)
+    template<bool IC>
+    Hub::EntityIterator<IC> Hub::EntityIterator<IC>::operator++(int)
     {
         EntityIterator ret = *this;
         increment();
         return ret;
     }
 
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A> & Hub::EntityIterator<IC, A>::operator+=(stick::Size _i)
+    template<bool IC>
+    Hub::EntityIterator<IC> & Hub::EntityIterator<IC>::operator+=(stick::Size _i)
     {
-        for (stick::Size i = 0; i <= _i; ++i)
-            increment();
+        moveToRank(rank() + _i);
         return *this;
     }
 
-    template<bool IC, bool A>
-    Hub::EntityIterator<IC, A> Hub::EntityIterator<IC, A>::operator+(stick::Size _i) const
+    template<bool IC>
+    Hub::EntityIterator<IC> Hub::EntityIterator<IC>::operator+(stick::Size _i) const
     {
         EntityIterator ret = *this;
-        for (stick::Size i = 0; i <= _i; ++i)
-            ret.increment();
+        ret += _i;
         return ret;
     }
 
-    template<bool IC, bool A>
-    void Hub::EntityIterator<IC, A>::increment()
+    template<bool IC>
+    typename Hub::EntityIterator<IC>::difference_type Hub::EntityIterator<IC>::operator-(const EntityIterator & _other) const
     {
-        STICK_ASSERT(m_hub);
-        do
+        return static_cast<difference_type>(rank()) - static_cast<difference_type>(_other.rank());
+    }
+
+    template<bool IC>
+    void Hub::EntityIterator<IC>::increment()
+    {
+        STICK_ASSERT(m_hub && m_current < m_hub->m_nextEntityID);
+        //step over the free ids in a row, the sorted free list is walked along with m_current
+        const FreeList & freeList = *m_freeList;
+        ++m_current;
+        while (m_freeListIndex < freeList.count() && freeList[m_freeListIndex] == m_current)
         {
+            ++m_freeListIndex;
             ++m_current;
         }
-        while (m_current < m_hub->m_nextEntityID && !isValidEntity());
     }
 
-    template<bool IC, bool A>
-    void Hub::EntityIterator<IC, A>::decrement()
+    template<bool IC>
+    void Hub::EntityIterator<IC>::decrement()
     {
         STICK_ASSERT(m_hub);
-        do
+        STICK_ASSERT(rank() > 0);
+        const FreeList & freeList = *m_freeList;
+        --m_current;
+        while (m_freeListIndex && freeList[m_freeListIndex - 1] == m_current)
         {
+            --m_freeListIndex;
             --m_current;
         }
-        while (m_current > 0 && !isValidEntity());
     }
 
-    template<bool IC, bool A>
-    typename Hub::EntityIterator<IC, A>::EntityType Hub::EntityIterator<IC, A>::operator * () const
+    template<bool IC>
+    typename Hub::EntityIterator<IC>::EntityType Hub::EntityIterator<IC>::operator * () const
     {
         return EntityType(const_cast<Hub *>(m_hub), m_current, m_hub->m_handleVersions[m_current]);
     }
 
-    template<bool IC, bool A>
-    bool Hub::EntityIterator<IC, A>::isValidEntity()
+    template<bool IC>
+    typename Hub::EntityIterator<IC>::EntityType Hub::EntityIterator<IC>::operator [] (stick::Size _i) const
+    {
+        return *(*this + _i);
+    }
+
+    template<bool IC>
+    stick::Size Hub::EntityIterator<IC>::rank() const
+    {
+        return m_current - m_freeListIndex;
+    }
+
+    template<bool IC>
+    void Hub::EntityIterator<IC>::moveToRank(stick::Size _rank)
     {
-        if (A)
+        //the i-th free id has f[i] - i alive ids below it, which never decreases, so the
+        //number of free ids below the entity with _rank is the number of f[i] - i <= _rank
+        const FreeList & freeList = *m_freeList;
+        stick::Size lo = 0;
+        stick::Size hi = freeList.count();
+        while (lo < hi)
         {
-            if (m_freeListIndex < m_freeListAccessor.freeList().count() && m_freeListAccessor.freeList()[m_freeListIndex] == m_current)
-            {
-                m_freeListIndex++;
-                return false;
-            }
-            return true;
+            stick::Size mid = lo + (hi - lo) / 2;
+            if (freeList[mid] - mid <= _rank)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        m_freeListIndex = lo;
+        m_current = std::min(_rank + lo, (stick::Size)m_hub->m_nextEntityID);
+    }
+
+    template<bool IC>
+    Hub::ViewIterator<IC>::ViewIterator() :
+        m_hub(nullptr),
+        m_entities(nullptr),
+        m_position(0)
+    {
+    }
+
+    template<bool IC>
+    Hub::ViewIterator<IC>::ViewIterator(HubPtr _hub, const stick::DynamicArray<EntityID> * _entities, stick::Size _position, const ComponentBitset & _mask) :
+        m_hub(_hub),
+        m_entities(_entities),
+        m_position(_position),
+        m_mask(_mask)
+    {
+        skip();
+    }
+
+    template<bool IC>
+    bool Hub::ViewIterator<IC>::operator == (const ViewIterator & _other) const
+    {
+        return m_position == _other.m_position;
+    }
+
+    template<bool IC>
+    bool Hub::ViewIterator<IC>::operator != (const ViewIterator & _other) const
+    {
+        return m_position != _other.m_position;
+    }
+
+    template<bool IC>
+    Hub::ViewIterator<IC> & Hub::ViewIterator<IC>::operator++()
+    {
+        BRICK_COUNT(m_hub, viewIterations, 1);
+        --m_position;
+        skip();
+        return *this;
+    }
+
+    template<bool IC>
+    Hub::ViewIterator<IC> Hub::ViewIterator<IC>::operator++(int)
+    {
+        ViewIterator ret = *this;
+        ++(*this);
+        return ret;
+    }
+
+    template<bool IC>
+    typename Hub::ViewIterator<IC>::EntityType Hub::ViewIterator<IC>::operator * () const
+    {
+        EntityID id = m_entities ? (*m_entities)[m_position - 1] : m_position - 1;
+        return EntityType(const_cast<Hub *>(m_hub), id, m_hub->m_handleVersions[id]);
+    }
+
+    template<bool IC>
+    void Hub::ViewIterator<IC>::skip()
+    {
+        while (m_position > 0 && !isValidEntity())
+            --m_position;
+    }
+
+    template<bool IC>
+    bool Hub::ViewIterator<IC>::isValidEntity() const
+    {
+        //components might have been removed during iteration
+        if (!m_entities)
+            return m_position <= m_hub->m_componentBitsets.count() && (m_hub->m_componentBitsets[m_position - 1] & m_mask) == m_mask;
+        if (m_position > m_entities->count())
+            return false;
+        return (m_hub->m_componentBitsets[(*m_entities)[m_position - 1]] & m_mask) == m_mask;
+    }
+
+    template<class...C>
+    stick::Size Hub::migrate(const TypedEntityRange<C...> & _view, Hub & _target, const RemapFunction & _fn)
+    {
+        //collect first, migrating removes the components the view iterates
+        stick::DynamicArray<EntityID> ids(*m_alloc);
+        stick::DynamicArray<stick::Size> versions(*m_alloc);
+        for (const Entity & e : _view)
+        {
+            ids.append(e.m_id);
+            versions.append(e.m_version);
+        }
+
+        stick::DynamicArray<EntityID> targetIDs(*m_alloc);
+        migrateEntities(ids, _target, targetIDs);
+
+        if (_fn)
+        {
+            for (stick::Size i = 0; i < ids.count(); ++i)
+                _fn(Entity(this, ids[i], versions[i]), _target.entityForID(targetIDs[i]));
         }
+        return ids.count();
+    }
+
+    template<class T>
+    ComponentBuffer<typename T::ValueType> & Hub::componentBuffer()
+    {
+        static_assert(!T::IsTag, "tags don't have a storage to buffer");
+        using Buffer = ComponentBuffer<typename T::ValueType>;
+        stick::Size cid = componentID<T>();
+        if (m_componentBuffers.count() <= cid)
+            m_componentBuffers.resize(cid + 1);
+        auto & ptr = m_componentBuffers[cid];
+        if (!ptr)
+            ptr = stick::UniquePtr<ComponentBufferBase>(m_alloc->create<Buffer>(*m_alloc), *m_alloc);
+        return static_cast<Buffer &>(*ptr);
+    }
+
+    template<class T, class...Args>
+    typename T::ValueType & Hub::setSingleton(Args && ..._args)
+    {
+        using Singleton = SingletonT<typename T::ValueType>;
+        stick::Size cid = componentID<T>();
+        if (m_singletons.count() <= cid)
+            m_singletons.resize(cid + 1);
+        auto & ptr = m_singletons[cid];
+        if (ptr)
+            detail::assignComponent(static_cast<Singleton &>(*ptr).value(), std::forward<Args>(_args)...);
         else
+            ptr = stick::UniquePtr<SingletonBase>(m_alloc->create<Singleton>(std::forward<Args>(_args)...), *m_alloc);
+        return static_cast<Singleton &>(*ptr).value();
+    }
+
+    template<class T>
+    typename T::ValueType & Hub::singleton()
+    {
+        STICK_ASSERT(hasSingleton<T>());
+        return static_cast<SingletonT<typename T::ValueType> &>(*m_singletons[componentID<T>()]).value();
+    }
+
+    template<class T>
+    const typename T::ValueType & Hub::singleton() const
+    {
+        STICK_ASSERT(hasSingleton<T>());
+        return static_cast<const SingletonT<typename T::ValueType> &>(*m_singletons[componentID<T>()]).value();
+    }
+
+    template<class T>
+    bool Hub::hasSingleton() const
+    {
+        stick::Size cid = componentID<T>();
+        return cid < m_singletons.count() && m_singletons[cid];
+    }
+
+    template<class T>
+    void Hub::removeSingleton()
+    {
+        stick::Size cid = componentID<T>();
+        if (cid < m_singletons.count())
+            m_singletons[cid].reset();
+    }
+
+    template<class...T>
+    void Hub::swapBuffers()
+    {
+        BRICK_TRACE_SCOPE("Hub::swapBuffers");
+        ++m_bufferGeneration;
+        int dummy[] = {0, (componentBuffer<T>().publish(storageFor<typename T::ValueType>(ensureStorage<T>()), m_bufferGeneration, *m_alloc), 0)...};
+        (void)dummy;
+    }
+
+    template<class T>
+    ComponentObserver & Hub::addObserver(stick::UniquePtr<ComponentObserver> _observer)
+    {
+        static_assert(!T::IsTag, "tags can't be observed");
+        ComponentObserver & ret = *_observer;
+        addObserver(componentID<T>(), std::move(_observer));
+        return ret;
+    }
+
+    template<class T>
+    SpatialIndex & Hub::enableSpatialIndex(stick::Float32 _cellSize)
+    {
+        static_assert(!T::IsTag, "tags can't be indexed");
+        stick::Size cid = componentID<T>();
+        STICK_ASSERT(cid >= m_spatialIndices.count() || !m_spatialIndices[cid]);
+        while (m_spatialIndices.count() <= cid)
+            m_spatialIndices.append(nullptr);
+        auto * index = m_alloc->create<SpatialIndexT<typename T::ValueType>>(*m_alloc, _cellSize);
+        m_spatialIndices[cid] = index;
+        addObserver(cid, stick::UniquePtr<ComponentObserver>(index, *m_alloc));
+        return *index;
+    }
+
+    template<class T>
+    const SpatialIndex & Hub::spatialIndex() const
+    {
+        stick::Size cid = componentID<T>();
+        STICK_ASSERT(cid < m_spatialIndices.count() && m_spatialIndices[cid]);
+        return *m_spatialIndices[cid];
+    }
+
+    template<class T>
+    stick::Size Hub::query(const AABB & _bounds, stick::DynamicArray<Entity> & _out) const
+    {
+        BRICK_TRACE_SCOPE("Hub::query");
+        stick::Size count = _out.count();
+        spatialIndex<T>().query(_bounds, [&](EntityID _id)
+        {
+            _out.append(entityForID(_id));
+        });
+        return _out.count() - count;
+    }
+
+    template<class T>
+    stick::DynamicArray<Entity> Hub::query(const AABB & _bounds) const
+    {
+        stick::DynamicArray<Entity> ret(*m_alloc);
+        query<T>(_bounds, ret);
+        return ret;
+    }
+
+    template<class T>
+    ComponentIndex<typename T::ValueType> & Hub::enableIndex(bool _bUnique)
+    {
+        return enableIndex<T>([](const typename T::ValueType & _value) -> const typename T::ValueType & { return _value; }, _bUnique);
+    }
+
+    template<class T, class F>
+    ComponentIndex<typename std::decay<typename std::result_of<F(const typename T::ValueType &)>::type>::type> &
+    Hub::enableIndex(F _keyFn, bool _bUnique)
+    {
+        static_assert(!T::IsTag, "tags can't be indexed");
+        using KeyType = typename std::decay<typename std::result_of<F(const typename T::ValueType &)>::type>::type;
+        stick::Size cid = componentID<T>();
+        STICK_ASSERT(cid >= m_indices.count() || !m_indices[cid]);
+        while (m_indices.count() <= cid)
+            m_indices.append(nullptr);
+        auto * index = m_alloc->create<ComponentIndexT<typename T::ValueType, KeyType, F>>(*m_alloc, _bUnique, std::move(_keyFn));
+        m_indices[cid] = index;
+        addObserver(cid, stick::UniquePtr<ComponentObserver>(index, *m_alloc));
+        return *index;
+    }
+
+    template<class T, class K>
+    const ComponentIndex<K> & Hub::index() const
+    {
+        stick::Size cid = componentID<T>();
+        STICK_ASSERT(cid < m_indices.count() && m_indices[cid]);
+        STICK_ASSERT(m_indices[cid]->keyTypeID() == stick::TypeInfoT<K>::typeID());
+        return *static_cast<const ComponentIndex<K> *>(m_indices[cid]);
+    }
+
+    template<class T, class K>
+    Entity Hub::find(const typename detail::NonDeduced<K>::Type & _key) const
+    {
+        EntityID id = index<T, K>().findFirst(_key);
+        return id != InvalidEntityID ? entityForID(id) : Entity();
+    }
+
+    template<class T, class K>
+    stick::Size Hub::findAll(const typename detail::NonDeduced<K>::Type & _key, stick::DynamicArray<Entity> & _out) const
+    {
+        stick::Size count = _out.count();
+        index<T, K>().visit(_key, [&](EntityID _id)
+        {
+            _out.append(entityForID(_id));
+        });
+        return _out.count() - count;
+    }
+
+    template<class T, class...Dependents, class F>
+    void Hub::sort(F _compare)
+    {
+        ComponentStorage * s = storage(componentID<T>());
+        if (!s)
+            return;
+        storageFor<typename T::ValueType>(*s).sort(_compare, *m_alloc);
+        int dummy[] = {0, (sortByEntityOrder<Dependents, T>(), 0)...};
+        (void)dummy;
+    }
+
+    template<class T, class U>
+    void Hub::sortByEntityOrder()
+    {
+        ComponentStorage * s = storage(componentID<T>());
+        const ComponentStorage * other = storage(componentID<U>());
+        if (s && other)
+            s->sortByEntityOrder(*other);
+    }
+
+    template<class...Dependents>
+    void Hub::sortHierarchy()
+    {
+        if (m_bHierarchyDirty)
         {
-            return (m_hub->m_componentBitsets[m_current] & m_mask) == m_mask;
+            orderHierarchy();
+            m_bHierarchyDirty = false;
         }
+        int dummy[] = {0, (sortByEntityOrder<Dependents, Hierarchy>(), 0)...};
+        (void)dummy;
     }
 
     template<class ... Components>
@@ -645,13 +2867,24 @@ namespace brick
     bool Hub::cloneComponentImpl(EntityID _from, EntityID _to)
     {
         stick::Size cid = componentID<Component>();
+        if (std::is_same<Component, Hierarchy>::value)
+        {
+            cloneHierarchy(_from, _to);
+            return m_componentBitsets[_to][cid];
+        }
+        if (Component::IsTag)
+        {
+            if (!m_componentBitsets[_from][cid])
+                return false;
+            m_componentBitsets[_to][cid] = true;
+            return true;
+        }
         if (cid < m_componentStorage.count())
         {
             auto & ptr = m_componentStorage[cid];
             //@TODO: shouldn't the storage always be valid here? replace with assert?
-            if (ptr && m_componentBitsets[_from][cid])
+            if (ptr && m_componentBitsets[_from][cid] && ptr->cloneComponent(_from, _to))
             {
-                ptr->cloneComponent(_from, _to);
                 m_componentBitsets[_to][cid] = true;
                 return true;
             }
@@ -671,16 +2904,23 @@ namespace brick
     template<class ... Components>
     void Hub::cloneComponentsWithout(EntityID _from, EntityID _to)
     {
+        stick::Size hid = componentID<Hierarchy>();
         for (stick::Size i = 0; i < m_componentStorage.count(); ++i)
         {
             auto & ptr = m_componentStorage[i];
             //@TODO: shouldn't the storage always be valid here? replace with assert?
-            if (ptr && !contains<Components...>(i) && m_componentBitsets[_from][i])
-            {
-                ptr->cloneComponent(_from, _to);
+            if (ptr && i != hid && !contains<Components...>(i) && m_componentBitsets[_from][i] && ptr->cloneComponent(_from, _to))
+                m_componentBitsets[_to][i] = true;
+        }
+        if (!contains<Components...>(hid))
+            cloneHierarchy(_from, _to);
+        ComponentBitset tags = tagBits(m_componentBitsets[_from]);
+        for (stick::Size i = 0; i < tags.size(); ++i)
+        {
+            if (tags[i] && !contains<Components...>(i))
                 m_componentBitsets[_to][i] = true;
-            }
         }
+        m_entityTypes[_to] = m_entityTypes[_from];
     }
 
     template<class Component>
@@ -688,6 +2928,9 @@ namespace brick
     {
         using ValueType = typename Component::ValueType;
         stick::Size cid = componentID<Component>();
+        //tags don't have anything to reserve
+        if (Component::IsTag)
+            return true;
         if (m_componentStorage.count() <= cid)
         {
             m_componentStorage.resize(cid + 1);
@@ -698,10 +2941,7 @@ namespace brick
         {
             createStorageForComponentID<ValueType>(cid, s);
         }
-        else
-        {
-            storage->resize(s);
-        }
+        storage->reserve(s);
         return true;
     }
 
@@ -737,6 +2977,7 @@ namespace brick
                 Entity e = createNextEntity();
                 m_freeList.append(e.m_id);
             }
+            freeListChanged();
         }
 
         //reserve the components passed in via template args
@@ -0,0 +1,203 @@
+#include <Brick/PagedArena.hpp>
+
+#include <cstdint>
+#include <cstring>
+
+namespace brick
+{
+    using namespace stick;
+
+    namespace
+    {
+        inline char * alignForward(char * _ptr, Size _alignment)
+        {
+            std::uintptr_t p = reinterpret_cast<std::uintptr_t>(_ptr);
+            return reinterpret_cast<char *>((p + _alignment - 1) & ~(std::uintptr_t)(_alignment - 1));
+        }
+    }
+
+    constexpr Size PagedArena::DefaultPageSize;
+
+    PagedArena::PagedArena(Allocator & _parent, Size _pageSize) :
+        m_parent(&_parent),
+        m_pageSize(_pageSize),
+        m_first(nullptr),
+        m_current(nullptr),
+        m_cursor(nullptr),
+        m_lastAllocation(nullptr)
+    {
+
+    }
+
+    PagedArena::~PagedArena()
+    {
+        release();
+    }
+
+    char * PagedArena::pageBegin(Page * _page) const
+    {
+        return reinterpret_cast<char *>(_page) + sizeof(Page);
+    }
+
+    char * PagedArena::pageEnd(Page * _page) const
+    {
+        return reinterpret_cast<char *>(_page) + _page->byteCount;
+    }
+
+    bool PagedArena::nextPage(Size _minByteCount)
+    {
+        //try to reuse a page that was retained by reset()
+        Page * prev = m_current;
+        Page * page = m_current ? m_current->next : m_first;
+        while (page && (Size)(pageEnd(page) - pageBegin(page)) < _minByteCount)
+        {
+            prev = page;
+            page = page->next;
+        }
+
+        if (page)
+        {
+            //unlink it...
+            if (prev)
+                prev->next = page->next;
+            else
+                m_first = page->next;
+        }
+        else
+        {
+            Size byteCount = sizeof(Page) + _minByteCount;
+            if (byteCount < m_pageSize)
+                byteCount = m_pageSize;
+            Block blk = m_parent->allocate(byteCount, alignof(Page));
+            if (!blk.ptr)
+                return false;
+            page = reinterpret_cast<Page *>(blk.ptr);
+            page->byteCount = byteCount;
+        }
+
+        //...and make it the page following the current one
+        if (m_current)
+        {
+            page->next = m_current->next;
+            m_current->next = page;
+        }
+        else
+        {
+            page->next = m_first;
+            m_first = page;
+        }
+
+        m_current = page;
+        m_cursor = pageBegin(page);
+        return true;
+    }
+
+    Block PagedArena::allocate(Size _byteCount, Size _alignment)
+    {
+        if (!_alignment)
+            _alignment = alignof(Size);
+
+        char * ptr = m_current ? alignForward(m_cursor, _alignment) : nullptr;
+        if (!ptr || ptr + _byteCount > pageEnd(m_current))
+        {
+            if (!nextPage(_byteCount + _alignment))
+                return {nullptr, 0};
+            ptr = alignForward(m_cursor, _alignment);
+        }
+        m_cursor = ptr + _byteCount;
+        m_lastAllocation = ptr;
+        return {ptr, _byteCount};
+    }
+
+    Block PagedArena::reallocate(const Block & _block, Size _byteCount, Size _alignment)
+    {
+        if (!_block.ptr)
+            return allocate(_byteCount, _alignment);
+
+        //grow/shrink in place if this is the most recent allocation
+        if (_block.ptr == m_lastAllocation && reinterpret_cast<char *>(_block.ptr) + _byteCount <= pageEnd(m_current))
+        {
+            m_cursor = reinterpret_cast<char *>(_block.ptr) + _byteCount;
+            return {_block.ptr, _byteCount};
+        }
+
+        Block ret = allocate(_byteCount, _alignment);
+        if (ret.ptr)
+            std::memcpy(ret.ptr, _block.ptr, _block.byteCount < _byteCount ? _block.byteCount : _byteCount);
+        return ret;
+    }
+
+    void PagedArena::deallocate(const Block & _block)
+    {
+        //only the most recent allocation can be given back
+        if (_block.ptr && _block.ptr == m_lastAllocation)
+        {
+            m_cursor = reinterpret_cast<char *>(_block.ptr);
+            m_lastAllocation = nullptr;
+        }
+    }
+
+    void PagedArena::reset()
+    {
+        m_current = nullptr;
+        m_cursor = nullptr;
+        m_lastAllocation = nullptr;
+        if (m_first)
+        {
+            m_current = m_first;
+            m_cursor = pageBegin(m_first);
+        }
+    }
+
+    void PagedArena::release()
+    {
+        Page * page = m_first;
+        while (page)
+        {
+            Page * next = page->next;
+            m_parent->deallocate({page, page->byteCount});
+            page = next;
+        }
+        m_first = nullptr;
+        m_current = nullptr;
+        m_cursor = nullptr;
+        m_lastAllocation = nullptr;
+    }
+
+    bool PagedArena::owns(const Block & _block) const
+    {
+        const char * ptr = reinterpret_cast<const char *>(_block.ptr);
+        for (Page * page = m_first; page; page = page->next)
+        {
+            if (ptr >= pageBegin(page) && ptr < pageEnd(page))
+                return true;
+        }
+        return false;
+    }
+
+    Size PagedArena::pageSize() const
+    {
+        return m_pageSize;
+    }
+
+    Size PagedArena::pageCount() const
+    {
+        Size ret = 0;
+        for (Page * page = m_first; page; page = page->next)
+            ++ret;
+        return ret;
+    }
+
+    Size PagedArena::reservedByteCount() const
+    {
+        Size ret = 0;
+        for (Page * page = m_first; page; page = page->next)
+            ret += page->byteCount;
+        return ret;
+    }
+
+    Allocator & PagedArena::parent() const
+    {
+        return *m_parent;
+    }
+}
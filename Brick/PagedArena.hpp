@@ -0,0 +1,76 @@
+#ifndef BRICK_PAGEDARENA_HPP
+#define BRICK_PAGEDARENA_HPP
+
+#include <Stick/Allocator.hpp>
+
+namespace brick
+{
+    // Linear allocator that hands out memory from a list of pages requested from
+    // a parent allocator. Individual deallocations are no-ops unless they release the
+    // most recent allocation. reset() rewinds the arena without returning the pages
+    // to the parent so that they can be reused, release() gives them back.
+    //
+    // As a consequence the old block of an array that grows by reallocating (anything
+    // but the most recent allocation) stays reserved until the next reset() or release().
+    // Arrays that grow geometrically leave less behind than they hold, so this at most
+    // doubles the memory of the growing arrays. Hub::clear() and Hub::compact() reclaim it.
+    class STICK_API PagedArena : public stick::Allocator
+    {
+    public:
+
+        static constexpr stick::Size DefaultPageSize = 64 * 1024;
+
+
+        PagedArena(stick::Allocator & _parent = stick::defaultAllocator(), stick::Size _pageSize = DefaultPageSize);
+
+        ~PagedArena();
+
+        PagedArena(const PagedArena &) = delete;
+
+        PagedArena & operator = (const PagedArena &) = delete;
+
+        stick::Block allocate(stick::Size _byteCount, stick::Size _alignment);
+
+        stick::Block reallocate(const stick::Block & _block, stick::Size _byteCount, stick::Size _alignment);
+
+        void deallocate(const stick::Block & _block);
+
+        void reset();
+
+        void release();
+
+        bool owns(const stick::Block & _block) const;
+
+        stick::Size pageSize() const;
+
+        stick::Size pageCount() const;
+
+        // total number of bytes requested from the parent allocator
+        stick::Size reservedByteCount() const;
+
+        stick::Allocator & parent() const;
+
+    private:
+
+        struct Page
+        {
+            Page * next;
+            stick::Size byteCount;
+        };
+
+        char * pageBegin(Page * _page) const;
+
+        char * pageEnd(Page * _page) const;
+
+        bool nextPage(stick::Size _minByteCount);
+
+        stick::Allocator * m_parent;
+        stick::Size m_pageSize;
+        Page * m_first;
+        Page * m_current;
+        char * m_cursor;
+        void * m_lastAllocation;
+    };
+}
+
+#endif //BRICK_PAGEDARENA_HPP
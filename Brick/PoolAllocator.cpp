@@ -0,0 +1,137 @@
+#include <Brick/PoolAllocator.hpp>
+
+
+namespace brick
+{
+    using namespace stick;
+
+    PoolAllocator::PoolAllocator(Allocator & _parent, Size _blockSize, Size _alignment, Size _blocksPerChunk, Size _maxBlocksPerChunk) :
+        m_parent(&_parent),
+        m_blockSize(_blockSize),
+        m_alignment(_alignment < alignof(FreeBlock) ? alignof(FreeBlock) : _alignment),
+        m_firstBlocksPerChunk(_blocksPerChunk ? _blocksPerChunk : 1),
+        m_blocksPerChunk(m_firstBlocksPerChunk),
+        m_maxBlocksPerChunk(_maxBlocksPerChunk > m_firstBlocksPerChunk ? _maxBlocksPerChunk : m_firstBlocksPerChunk),
+        m_chunks(nullptr),
+        m_freeList(nullptr),
+        m_freeCount(0)
+    {
+        //every block needs to be able to hold the free list link
+        if (m_blockSize < sizeof(FreeBlock))
+            m_blockSize = sizeof(FreeBlock);
+        //round the block size up so that consecutive blocks stay aligned
+        m_blockSize = (m_blockSize + m_alignment - 1) & ~(m_alignment - 1);
+    }
+
+    PoolAllocator::~PoolAllocator()
+    {
+        release();
+    }
+
+    bool PoolAllocator::allocateChunk()
+    {
+        Size headerSize = (sizeof(Chunk) + m_alignment - 1) & ~(m_alignment - 1);
+        Size byteCount = headerSize + m_blockSize * m_blocksPerChunk;
+        Block blk = m_parent->allocate(byteCount, m_alignment);
+        if (!blk.ptr)
+            return false;
+
+        Chunk * chunk = reinterpret_cast<Chunk *>(blk.ptr);
+        chunk->byteCount = byteCount;
+        chunk->next = m_chunks;
+        m_chunks = chunk;
+
+        //push the blocks in reverse so that they are handed out in address order
+        char * first = reinterpret_cast<char *>(blk.ptr) + headerSize;
+        for (Size i = m_blocksPerChunk; i > 0; --i)
+        {
+            FreeBlock * fb = reinterpret_cast<FreeBlock *>(first + (i - 1) * m_blockSize);
+            fb->next = m_freeList;
+            m_freeList = fb;
+        }
+        m_freeCount += m_blocksPerChunk;
+        //grow geometrically
+        m_blocksPerChunk = m_blocksPerChunk * 2 < m_maxBlocksPerChunk ? m_blocksPerChunk * 2 : m_maxBlocksPerChunk;
+        return true;
+    }
+
+    Block PoolAllocator::allocate(Size _byteCount, Size _alignment)
+    {
+        STICK_ASSERT(_byteCount <= m_blockSize);
+        STICK_ASSERT(_alignment <= m_alignment);
+        if (_byteCount > m_blockSize || (!m_freeList && !allocateChunk()))
+            return {nullptr, 0};
+
+        FreeBlock * ret = m_freeList;
+        m_freeList = ret->next;
+        --m_freeCount;
+        return {ret, _byteCount};
+    }
+
+    Block PoolAllocator::reallocate(const Block & _block, Size _byteCount, Size _alignment)
+    {
+        if (!_block.ptr)
+            return allocate(_byteCount, _alignment);
+        //all blocks have the same size, so this either fits or fails
+        STICK_ASSERT(_byteCount <= m_blockSize);
+        if (_byteCount > m_blockSize)
+            return {nullptr, 0};
+        return {_block.ptr, _byteCount};
+    }
+
+    void PoolAllocator::deallocate(const Block & _block)
+    {
+        if (!_block.ptr)
+            return;
+        FreeBlock * fb = reinterpret_cast<FreeBlock *>(_block.ptr);
+        fb->next = m_freeList;
+        m_freeList = fb;
+        ++m_freeCount;
+    }
+
+    void PoolAllocator::reset()
+    {
+        m_chunks = nullptr;
+        m_freeList = nullptr;
+        m_freeCount = 0;
+        m_blocksPerChunk = m_firstBlocksPerChunk;
+    }
+
+    void PoolAllocator::release()
+    {
+        Chunk * chunk = m_chunks;
+        while (chunk)
+        {
+            Chunk * next = chunk->next;
+            m_parent->deallocate({chunk, chunk->byteCount});
+            chunk = next;
+        }
+        reset();
+    }
+
+    Size PoolAllocator::blockSize() const
+    {
+        return m_blockSize;
+    }
+
+    Size PoolAllocator::chunkCount() const
+    {
+        Size ret = 0;
+        for (Chunk * chunk = m_chunks; chunk; chunk = chunk->next)
+            ++ret;
+        return ret;
+    }
+
+    Size PoolAllocator::freeBlockCount() const
+    {
+        return m_freeCount;
+    }
+
+    Size PoolAllocator::reservedByteCount() const
+    {
+        Size ret = 0;
+        for (Chunk * chunk = m_chunks; chunk; chunk = chunk->next)
+            ret += chunk->byteCount;
+        return ret;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef BRICK_POOLALLOCATOR_HPP
+#define BRICK_POOLALLOCATOR_HPP
+
+#include <Stick/Allocator.hpp>
+
+namespace brick
+{
+    // Allocator for blocks of one fixed size. Blocks are carved out of chunks that are
+    // requested from a parent allocator and recycled through an intrusive free list,
+    // so allocating and freeing never fragments the parent. The first chunk holds
+    // _blocksPerChunk blocks, every following one twice as many as the one before up to
+    // _maxBlocksPerChunk, so pools that only ever hand out a few blocks stay small.
+    class STICK_API PoolAllocator : public stick::Allocator
+    {
+    public:
+
+        PoolAllocator(stick::Allocator & _parent, stick::Size _blockSize, stick::Size _alignment, stick::Size _blocksPerChunk = 1, stick::Size _maxBlocksPerChunk = 16);
+
+        ~PoolAllocator();
+
+        PoolAllocator(const PoolAllocator &) = delete;
+
+        PoolAllocator & operator = (const PoolAllocator &) = delete;
+
+        stick::Block allocate(stick::Size _byteCount, stick::Size _alignment);
+
+        stick::Block reallocate(const stick::Block & _block, stick::Size _byteCount, stick::Size _alignment);
+
+        void deallocate(const stick::Block & _block);
+
+        // forgets all blocks without touching the parent allocator. Only use this if
+        // the parent memory is released as a whole, i.e. when it is a PagedArena that is reset.
+        void reset();
+
+        // gives all chunks back to the parent allocator.
+        void release();
+
+        stick::Size blockSize() const;
+
+        stick::Size chunkCount() const;
+
+        stick::Size freeBlockCount() const;
+
+        stick::Size reservedByteCount() const;
+
+    private:
+
+        struct FreeBlock
+        {
+            FreeBlock * next;
+        };
+
+        struct Chunk
+        {
+            Chunk * next;
+            stick::Size byteCount;
+        };
+
+        bool allocateChunk();
+
+        stick::Allocator * m_parent;
+        stick::Size m_blockSize;
+        stick::Size m_alignment;
+        stick::Size m_firstBlocksPerChunk;
+        // number of blocks of the next chunk
+        stick::Size m_blocksPerChunk;
+        stick::Size m_maxBlocksPerChunk;
+        Chunk * m_chunks;
+        FreeBlock * m_freeList;
+        stick::Size m_freeCount;
+    };
+}
+
+#endif //BRICK_POOLALLOCATOR_HPP
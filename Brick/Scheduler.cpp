@@ -0,0 +1,159 @@
+#include <Brick/Scheduler.hpp>
+
+namespace brick
+{
+    using namespace stick;
+
+    Scheduler::Scheduler(Hub & _hub, Size _workerCount, Allocator & _alloc) :
+        m_hub(&_hub),
+        m_alloc(&_alloc),
+        m_systems(_alloc),
+        m_access(_alloc),
+        m_dependents(_alloc),
+        m_dependencyCounts(_alloc),
+        m_pending(_alloc),
+        m_readyQueue(_alloc),
+        m_workers(_alloc),
+        m_finishedCount(0),
+        m_bShutdown(false)
+    {
+        m_workers.reserve(_workerCount);
+        for (Size i = 0; i < _workerCount; ++i)
+            m_workers.append(UniquePtr<std::thread>(m_alloc->create<std::thread>(&Scheduler::workerLoop, this), *m_alloc));
+    }
+
+    Scheduler::~Scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_bShutdown = true;
+        }
+        m_condition.notify_all();
+        for (auto & t : m_workers)
+            t->join();
+    }
+
+    void Scheduler::buildGraph()
+    {
+        Size count = m_systems.count();
+        m_access.clear();
+        m_dependents.clear();
+        m_dependencyCounts.clear();
+        m_access.reserve(count);
+        m_dependents.resize(count);
+        m_dependencyCounts.resize(count);
+
+        //the component ids of the accessed components get resolved here on the
+        //calling thread, before any of the systems run.
+        for (Size i = 0; i < count; ++i)
+        {
+            m_access.append(m_systems[i]->access(*m_hub));
+            m_dependencyCounts[i] = 0;
+        }
+
+        //systems that were added later depend on all earlier systems they conflict
+        //with. This keeps the observable order of conflicting systems identical to
+        //running them one after another.
+        for (Size i = 0; i < count; ++i)
+        {
+            for (Size j = i + 1; j < count; ++j)
+            {
+                if (m_access[i].conflictsWith(m_access[j]))
+                {
+                    m_dependents[i].append(j);
+                    m_dependencyCounts[j]++;
+                }
+            }
+        }
+    }
+
+    void Scheduler::run()
+    {
+        if (!m_systems.count())
+            return;
+
+        buildGraph();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finishedCount = 0;
+        m_pending = m_dependencyCounts;
+        m_readyQueue.clear();
+        for (Size i = m_systems.count(); i > 0; --i)
+        {
+            if (!m_pending[i - 1])
+                m_readyQueue.append(i - 1);
+        }
+        m_condition.notify_all();
+
+        processTasks(lock, true);
+    }
+
+    void Scheduler::workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_condition.wait(lock, [this]() { return m_bShutdown || m_readyQueue.count(); });
+            if (m_bShutdown)
+                return;
+            processTasks(lock, false);
+        }
+    }
+
+    void Scheduler::processTasks(std::unique_lock<std::mutex> & _lock, bool _bWait)
+    {
+        while (true)
+        {
+            if (m_readyQueue.count())
+            {
+                Size index = m_readyQueue.last();
+                m_readyQueue.removeLast();
+                runSystem(_lock, index);
+            }
+            else if (_bWait && m_finishedCount < m_systems.count())
+            {
+                m_condition.wait(_lock, [this]() { return m_readyQueue.count() || m_finishedCount == m_systems.count(); });
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    void Scheduler::runSystem(std::unique_lock<std::mutex> & _lock, Size _index)
+    {
+        _lock.unlock();
+        m_systems[_index]->run(*m_hub);
+        _lock.lock();
+
+        //systems were added in order, so pushing the dependents in reverse
+        //makes the lowest index pop first from the ready queue.
+        auto & deps = m_dependents[_index];
+        for (Size i = deps.count(); i > 0; --i)
+        {
+            Size dep = deps[i - 1];
+            if (--m_pending[dep] == 0)
+                m_readyQueue.append(dep);
+        }
+        m_finishedCount++;
+        m_condition.notify_all();
+    }
+
+    Size Scheduler::systemCount() const
+    {
+        return m_systems.count();
+    }
+
+    Size Scheduler::workerCount() const
+    {
+        return m_workers.count();
+    }
+
+    Size Scheduler::defaultWorkerCount()
+    {
+        Size hc = std::thread::hardware_concurrency();
+        //the thread calling run() executes systems, too
+        return hc > 1 ? hc - 1 : 0;
+    }
+}
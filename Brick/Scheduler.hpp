@@ -0,0 +1,82 @@
+#ifndef BRICK_SCHEDULER_HPP
+#define BRICK_SCHEDULER_HPP
+
+#include <Brick/System.hpp>
+#include <Stick/DynamicArray.hpp>
+#include <Stick/UniquePtr.hpp>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace brick
+{
+    // Runs systems added to it once per call to run(). Each frame a dependency
+    // graph is built from the declared component access of the systems: a system
+    // depends on every previously added system it conflicts with. Systems without
+    // a conflict are executed concurrently on the worker threads (and the calling thread).
+    // Systems must not structurally change the hub unless they are declared Exclusive.
+    class STICK_API Scheduler
+    {
+    public:
+
+        Scheduler(Hub & _hub, stick::Size _workerCount = defaultWorkerCount(),
+                  stick::Allocator & _alloc = stick::defaultAllocator());
+
+        ~Scheduler();
+
+        Scheduler(const Scheduler &) = delete;
+
+        Scheduler & operator = (const Scheduler &) = delete;
+
+        template<class T, class...Args>
+        T & addSystem(Args && ..._args)
+        {
+            T * sys = m_alloc->create<T>(std::forward<Args>(_args)...);
+            m_systems.append(stick::UniquePtr<SystemBase>(sys, *m_alloc));
+            return *sys;
+        }
+
+        template<class...Access>
+        SystemBase & addFunction(typename FunctionSystem<Access...>::Function _fn)
+        {
+            return addSystem<FunctionSystem<Access...>>(std::move(_fn));
+        }
+
+        void run();
+
+        stick::Size systemCount() const;
+
+        stick::Size workerCount() const;
+
+        static stick::Size defaultWorkerCount();
+
+    private:
+
+        void buildGraph();
+
+        void workerLoop();
+
+        // executes ready systems until the frame is done or the queue is empty
+        // and _bWait is false
+        void processTasks(std::unique_lock<std::mutex> & _lock, bool _bWait);
+
+        void runSystem(std::unique_lock<std::mutex> & _lock, stick::Size _index);
+
+        Hub * m_hub;
+        stick::Allocator * m_alloc;
+        stick::DynamicArray<stick::UniquePtr<SystemBase>> m_systems;
+        stick::DynamicArray<SystemAccess> m_access;
+        stick::DynamicArray<stick::DynamicArray<stick::Size>> m_dependents;
+        stick::DynamicArray<stick::Size> m_dependencyCounts;
+        stick::DynamicArray<stick::Size> m_pending;
+        stick::DynamicArray<stick::Size> m_readyQueue;
+        stick::DynamicArray<stick::UniquePtr<std::thread>> m_workers;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        stick::Size m_finishedCount;
+        bool m_bShutdown;
+    };
+}
+
+#endif //BRICK_SCHEDULER_HPP
@@ -1,9 +1,11 @@
 #ifndef BRICK_SHAREDENTITY_HPP
 #define BRICK_SHAREDENTITY_HPP
 
-#include <Brick/Entity.hpp>
+#include <Brick/Hub.hpp>
 #include <Brick/Component.hpp>
 
+#include <atomic>
+
 namespace brick
 {
     namespace detail
@@ -12,6 +14,9 @@ namespace brick
         {
         public:
 
+            // name of the component linking an entity to its counter
+            using ComponentNameType = ComponentName("RefCounter");
+
             SimpleRefCounter() :
                 m_count(1)
             {
@@ -22,9 +27,10 @@ namespace brick
                 ++m_count;
             }
 
-            void decrement()
+            // returns the remaining count
+            stick::Size decrement()
             {
-                --m_count;
+                return --m_count;
             }
 
             stick::Size count() const
@@ -36,95 +42,235 @@ namespace brick
 
             stick::Size m_count;
         };
+
+        // Ref counter that can be incremented and decremented from multiple threads, use
+        // it for SharedEntities that are copied across job threads.
+        class AtomicRefCounter
+        {
+        public:
+
+            using ComponentNameType = ComponentName("AtomicRefCounter");
+
+            AtomicRefCounter() :
+                m_count(1)
+            {
+            }
+
+            void increment()
+            {
+                m_count.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // returns the remaining count
+            stick::Size decrement()
+            {
+                return m_count.fetch_sub(1, std::memory_order_acq_rel) - 1;
+            }
+
+            stick::Size count() const
+            {
+                return m_count.load(std::memory_order_acquire);
+            }
+
+        private:
+
+            std::atomic<stick::Size> m_count;
+        };
+
+        // Heap block holding the ref counter of a shared entity together with the
+        // allocator it came from. Its address is stable so it can be cached by the
+        // SharedEntity handles. Besides the handles, the RefCounter component of the
+        // entity holds a reference, so the block outlives both the entity and the last handle.
+        template<class RefCounter>
+        struct RefCounterBlock
+        {
+            RefCounterBlock(stick::Allocator & _alloc) :
+                allocator(&_alloc)
+            {
+            }
+
+            // drops one reference and frees the block if it was the last one.
+            // returns the remaining count.
+            stick::Size release()
+            {
+                stick::Size ret = counter.decrement();
+                if (ret == 0)
+                    allocator->destroy(this);
+                return ret;
+            }
+
+            RefCounter counter;
+            stick::Allocator * allocator;
+        };
+
+        // The component that links an entity to its ref counter block. It is not copyable
+        // so that cloning an entity does not share the counter with the clone.
+        template<class RefCounter>
+        struct RefCounterHandle
+        {
+            using Block = RefCounterBlock<RefCounter>;
+
+            RefCounterHandle(Block * _block = nullptr) :
+                block(_block)
+            {
+            }
+
+            RefCounterHandle(const RefCounterHandle &) = delete;
+
+            RefCounterHandle(RefCounterHandle && _other) :
+                block(_other.block)
+            {
+                _other.block = nullptr;
+            }
+
+            ~RefCounterHandle()
+            {
+                if (block)
+                    block->release();
+            }
+
+            RefCounterHandle & operator = (const RefCounterHandle &) = delete;
+
+            RefCounterHandle & operator = (RefCounterHandle && _other)
+            {
+                if (this == &_other)
+                    return *this;
+                if (block)
+                    block->release();
+                block = _other.block;
+                _other.block = nullptr;
+                return *this;
+            }
+
+            Block * block;
+        };
+
+        // Destroys the entity as soon as the last SharedEntity referencing it goes away.
+        struct ImmediateRelease
+        {
+            static void release(Entity & _entity)
+            {
+                if (_entity.isValid())
+                    _entity.destroy();
+            }
+        };
+
+        // Queues the entity for destruction by the next call to Hub::collectGarbage()
+        // so that dropping many handles does not stall and handles can be released
+        // from any thread.
+        struct DeferredRelease
+        {
+            static void release(Entity & _entity)
+            {
+                _entity.hub()->queueDestroy(_entity);
+            }
+        };
     }
 
-    template<class RefCounter = detail::SimpleRefCounter>
+    // Entity handle that releases the entity once the last SharedEntity referencing it
+    // goes away. How the entity is released is up to the ReleasePolicy, see detail::ImmediateRelease
+    // and detail::DeferredRelease. Copying only touches the cached ref counter, not the hub, so
+    // handles using detail::AtomicRefCounter and detail::DeferredRelease can be copied and released on any thread.
+    template<class RefCounter = detail::SimpleRefCounter, class ReleasePolicy = detail::ImmediateRelease>
     class STICK_API SharedEntity : public Entity
     {
     public:
 
-        using RefCounterComponent = Component<ComponentName("RefCounter"), RefCounter>;
+        using RefCounterComponent = Component<typename RefCounter::ComponentNameType, detail::RefCounterHandle<RefCounter>>;
+
+        using Block = detail::RefCounterBlock<RefCounter>;
 
-        SharedEntity()
+        SharedEntity() :
+            m_block(nullptr)
         {
 
         }
 
         SharedEntity(const SharedEntity & _other) :
-            Entity(_other)
+            Entity(_other),
+            m_block(_other.m_block)
         {
-            auto refCount = maybe<RefCounterComponent>();
-            if (refCount)
-            {
-                (*refCount).increment();
-            }
+            if (m_block)
+                m_block->counter.increment();
         }
 
         SharedEntity(SharedEntity && _other) :
-            Entity(std::move(_other))
+            Entity(std::move(_other)),
+            m_block(_other.m_block)
         {
+            _other.m_block = nullptr;
             _other.Entity::invalidate();
         }
 
         ~SharedEntity()
         {
-            if (isValid())
-            {
-                invalidate();
-            }
+            invalidate();
         }
 
         SharedEntity & operator = (const SharedEntity & _other)
         {
+            if (this == &_other)
+                return *this;
+            //increment first in case both handles share the counter
+            if (_other.m_block)
+                _other.m_block->counter.increment();
             invalidate();
-            assignEntity(_other);
+            Entity::assignEntity(_other);
+            m_block = _other.m_block;
             return *this;
         }
 
         SharedEntity & operator = (SharedEntity && _other)
         {
+            if (this == &_other)
+                return *this;
             invalidate();
             Entity::operator = (std::move(_other));
+            m_block = _other.m_block;
+            _other.m_block = nullptr;
             _other.Entity::invalidate();
             return *this;
         }
 
         void invalidate()
         {
-            if (!isValid()) return;
-            auto refCount = maybe<RefCounterComponent>();
-            if (refCount)
-            {
-                (*refCount).decrement();
-                if ((*refCount).count() == 0)
-                {
-                    Entity::destroy();
-                }
-                else
-                {
-                    Entity::invalidate();
-                }
-            }
+            Block * block = m_block;
+            m_block = nullptr;
+            //if only the reference of the entity itself is left, release the entity.
+            //If the entity was destroyed by other means already, the block is gone now.
+            if (block && block->release() == 1)
+                ReleasePolicy::release(*this);
+            Entity::invalidate();
         }
 
         stick::Size referenceCount() const
         {
-            auto refCount = maybe<RefCounterComponent>();
-            return refCount ? (*refCount).count() : 0;
+            if (!m_block)
+                return 0;
+            //don't count the reference of the entity itself
+            return m_block->counter.count() - (isValid() ? 1 : 0);
         }
 
         void assignEntity(const Entity & _e)
         {
             invalidate();
             Entity::assignEntity(_e);
-            auto refCount = maybe<RefCounterComponent>();
-            if (!refCount)
+            if (!isValid())
+                return;
+
+            auto handle = maybe<RefCounterComponent>();
+            if (handle && (*handle).block)
             {
-                set<RefCounterComponent>(RefCounter());
+                m_block = (*handle).block;
+                m_block->counter.increment();
             }
             else
             {
-                const_cast<RefCounter &>(*refCount).increment();
+                stick::Allocator & alloc = hub()->allocator();
+                m_block = alloc.template create<Block>(alloc);
+                //one reference for this handle, one for the entity
+                m_block->counter.increment();
+                set<RefCounterComponent>(m_block);
             }
         }
 
@@ -132,6 +278,8 @@ namespace brick
 
         using Entity::invalidate;
         using Entity::destroy;
+
+        Block * m_block;
     };
 }
 
@@ -0,0 +1,52 @@
+#ifndef BRICK_SHAREDPAGE_HPP
+#define BRICK_SHAREDPAGE_HPP
+
+#include <Brick/EntityID.hpp>
+#include <Stick/Allocator.hpp>
+
+#include <type_traits>
+
+namespace brick
+{
+    // number of components per page of a component storage
+    constexpr stick::Size ComponentPageSize = 128;
+
+    // Immutable copy of one page of a component storage, shared by the storage, the
+    // snapshots and the component buffers that captured the page while it was unchanged.
+    // It lives in the allocator of the hub rather than the arena, so it survives clear()
+    // and compact(). The reference count is not atomic, only the thread that owns the hub
+    // takes and releases references.
+    template<class T>
+    struct SharedPage
+    {
+        T * values()
+        {
+            return reinterpret_cast<T *>(&storage[0]);
+        }
+
+        const T * values() const
+        {
+            return reinterpret_cast<const T *>(&storage[0]);
+        }
+
+        static void release(SharedPage * _page)
+        {
+            if (--_page->refs)
+                return;
+            if (!std::is_trivially_destructible<T>::value)
+            {
+                for (stick::Size i = 0; i < _page->count; ++i)
+                    _page->values()[i].~T();
+            }
+            _page->allocator->destroy(_page);
+        }
+
+        stick::Allocator * allocator;
+        stick::Size refs;
+        stick::Size count;
+        EntityID entities[ComponentPageSize];
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage[ComponentPageSize];
+    };
+}
+
+#endif //BRICK_SHAREDPAGE_HPP
@@ -0,0 +1,312 @@
+#include <Brick/SpatialIndex.hpp>
+
+#include <cmath>
+#include <cstring>
+
+namespace brick
+{
+    using namespace stick;
+
+    namespace
+    {
+        // keeps the cell coordinates far away from overflowing when ranges are walked
+        constexpr Float32 MaxCellCoord = 1 << 30;
+
+        UInt32 hashCell(Int32 _x, Int32 _y, Int32 _z)
+        {
+            return (static_cast<UInt32>(_x) * 73856093u) ^ (static_cast<UInt32>(_y) * 19349663u) ^ (static_cast<UInt32>(_z) * 83492791u);
+        }
+    }
+
+    constexpr Size SpatialIndex::MaxEntityCells;
+    constexpr UInt32 SpatialIndex::InvalidSlot;
+
+    SpatialIndex::SpatialIndex(Allocator & _alloc, Float32 _cellSize) :
+        m_cellSize(_cellSize),
+        m_invCellSize(1.0f / _cellSize),
+        m_cells(_alloc),
+        m_table(_alloc),
+        m_entries(_alloc),
+        m_freeEntry(InvalidSlot),
+        m_records(_alloc),
+        m_oversized(_alloc),
+        m_count(0)
+    {
+        STICK_ASSERT(_cellSize > 0.0f);
+    }
+
+    void SpatialIndex::insert(EntityID _entity, const AABB & _bounds)
+    {
+        while (m_records.count() <= _entity)
+            m_records.append({{{0, 0, 0}, {0, 0, 0}}, {{0, 0, 0}}, {{0, 0, 0}}, InvalidSlot, InvalidSlot});
+
+        CellCoord min = cellCoord(_bounds.min);
+        CellCoord max = cellCoord(_bounds.max);
+        Float64 volume = 1.0;
+        for (Size i = 0; i < 3; ++i)
+            volume *= static_cast<Float64>(max.v[i]) - min.v[i] + 1.0;
+        bool bOversized = volume > MaxEntityCells;
+
+        Record & r = m_records[_entity];
+        if (contains(_entity))
+        {
+            bool bSameCells = std::memcmp(&min, &r.min, sizeof(CellCoord)) == 0 &&
+                              std::memcmp(&max, &r.max, sizeof(CellCoord)) == 0;
+            if (bOversized == (r.oversizedIndex != InvalidSlot) && (bOversized || bSameCells))
+            {
+                r.bounds = _bounds;
+                r.min = min;
+                r.max = max;
+                return;
+            }
+            unlink(r);
+        }
+        else
+        {
+            ++m_count;
+        }
+
+        r.bounds = _bounds;
+        r.min = min;
+        r.max = max;
+        if (bOversized)
+        {
+            r.oversizedIndex = static_cast<UInt32>(m_oversized.count());
+            m_oversized.append(_entity);
+            return;
+        }
+
+        CellCoord c;
+        for (c.v[0] = min.v[0]; c.v[0] <= max.v[0]; ++c.v[0])
+        {
+            for (c.v[1] = min.v[1]; c.v[1] <= max.v[1]; ++c.v[1])
+            {
+                for (c.v[2] = min.v[2]; c.v[2] <= max.v[2]; ++c.v[2])
+                {
+                    UInt32 cell = ensureCell(c);
+                    UInt32 entry = m_freeEntry;
+                    if (entry != InvalidSlot)
+                    {
+                        m_freeEntry = m_entries[entry].next;
+                    }
+                    else
+                    {
+                        entry = static_cast<UInt32>(m_entries.count());
+                        m_entries.append(Entry());
+                    }
+
+                    Entry & e = m_entries[entry];
+                    e.entity = _entity;
+                    e.cell = cell;
+                    e.prev = InvalidSlot;
+                    e.next = m_cells[cell].first;
+                    e.nextOfEntity = m_records[_entity].firstEntry;
+                    if (e.next != InvalidSlot)
+                        m_entries[e.next].prev = entry;
+                    m_cells[cell].first = entry;
+                    m_records[_entity].firstEntry = entry;
+                }
+            }
+        }
+    }
+
+    void SpatialIndex::remove(EntityID _entity)
+    {
+        if (!contains(_entity))
+            return;
+        unlink(m_records[_entity]);
+        --m_count;
+    }
+
+    void SpatialIndex::clear()
+    {
+        m_cells.clear();
+        for (UInt32 & slot : m_table)
+            slot = 0;
+        m_entries.clear();
+        m_freeEntry = InvalidSlot;
+        m_records.clear();
+        m_oversized.clear();
+        m_count = 0;
+    }
+
+    bool SpatialIndex::contains(EntityID _entity) const
+    {
+        return _entity < m_records.count() &&
+               (m_records[_entity].firstEntry != InvalidSlot || m_records[_entity].oversizedIndex != InvalidSlot);
+    }
+
+    Size SpatialIndex::count() const
+    {
+        return m_count;
+    }
+
+    Size SpatialIndex::cellCount() const
+    {
+        return m_cells.count();
+    }
+
+    Float32 SpatialIndex::cellSize() const
+    {
+        return m_cellSize;
+    }
+
+    void SpatialIndex::componentRemoved(EntityID _entity)
+    {
+        remove(_entity);
+    }
+
+    void SpatialIndex::componentsReset()
+    {
+        clear();
+    }
+
+    SpatialIndex::CellCoord SpatialIndex::cellCoord(const Float32 * _position) const
+    {
+        CellCoord ret;
+        for (Size i = 0; i < 3; ++i)
+        {
+            Float32 c = std::floor(_position[i] * m_invCellSize);
+            //NaN ends up in cell 0
+            if (!(c >= -MaxCellCoord))
+                c = c < 0.0f ? -MaxCellCoord : 0.0f;
+            if (c > MaxCellCoord)
+                c = MaxCellCoord;
+            ret.v[i] = static_cast<Int32>(c);
+        }
+        return ret;
+    }
+
+    UInt32 SpatialIndex::findCell(const CellCoord & _coord) const
+    {
+        if (!m_table.count())
+            return InvalidSlot;
+        Size mask = m_table.count() - 1;
+        for (Size i = hashCell(_coord.v[0], _coord.v[1], _coord.v[2]) & mask;; i = (i + 1) & mask)
+        {
+            UInt32 slot = m_table[i];
+            if (!slot)
+                return InvalidSlot;
+            if (std::memcmp(&m_cells[slot - 1].coord, &_coord, sizeof(CellCoord)) == 0)
+                return slot - 1;
+        }
+    }
+
+    UInt32 SpatialIndex::ensureCell(const CellCoord & _coord)
+    {
+        UInt32 ret = findCell(_coord);
+        if (ret != InvalidSlot)
+            return ret;
+
+        //keep the table at most half full
+        if ((m_cells.count() + 1) * 2 > m_table.count())
+            growTable();
+        ret = static_cast<UInt32>(m_cells.count());
+        m_cells.append({_coord, InvalidSlot});
+        Size mask = m_table.count() - 1;
+        Size i = hashCell(_coord.v[0], _coord.v[1], _coord.v[2]) & mask;
+        while (m_table[i])
+            i = (i + 1) & mask;
+        m_table[i] = ret + 1;
+        return ret;
+    }
+
+    Size SpatialIndex::tableSlot(UInt32 _cell) const
+    {
+        const CellCoord & coord = m_cells[_cell].coord;
+        Size mask = m_table.count() - 1;
+        Size i = hashCell(coord.v[0], coord.v[1], coord.v[2]) & mask;
+        while (m_table[i] != _cell + 1)
+            i = (i + 1) & mask;
+        return i;
+    }
+
+    void SpatialIndex::removeCell(UInt32 _cell)
+    {
+        //close the gap in the probe sequence by moving later cells back to it, so no tombstones are needed
+        Size mask = m_table.count() - 1;
+        Size gap = tableSlot(_cell);
+        for (Size i = (gap + 1) & mask; m_table[i]; i = (i + 1) & mask)
+        {
+            const CellCoord & coord = m_cells[m_table[i] - 1].coord;
+            Size home = hashCell(coord.v[0], coord.v[1], coord.v[2]) & mask;
+            if (((i - home) & mask) >= ((i - gap) & mask))
+            {
+                m_table[gap] = m_table[i];
+                gap = i;
+            }
+        }
+        m_table[gap] = 0;
+
+        //keep the cells dense by moving the last one into the freed slot
+        UInt32 last = static_cast<UInt32>(m_cells.count() - 1);
+        if (_cell != last)
+        {
+            m_table[tableSlot(last)] = _cell + 1;
+            m_cells[_cell] = m_cells[last];
+            for (UInt32 i = m_cells[_cell].first; i != InvalidSlot; i = m_entries[i].next)
+                m_entries[i].cell = _cell;
+        }
+        m_cells.removeLast();
+    }
+
+    void SpatialIndex::growTable()
+    {
+        Size capacity = m_table.count() ? m_table.count() * 2 : 64;
+        m_table.resize(capacity);
+        for (UInt32 & slot : m_table)
+            slot = 0;
+        Size mask = capacity - 1;
+        for (UInt32 c = 0; c < m_cells.count(); ++c)
+        {
+            const CellCoord & coord = m_cells[c].coord;
+            Size i = hashCell(coord.v[0], coord.v[1], coord.v[2]) & mask;
+            while (m_table[i])
+                i = (i + 1) & mask;
+            m_table[i] = c + 1;
+        }
+    }
+
+    void SpatialIndex::unlink(Record & _record)
+    {
+        if (_record.oversizedIndex != InvalidSlot)
+        {
+            EntityID moved = m_oversized.last();
+            m_oversized[_record.oversizedIndex] = moved;
+            m_records[moved].oversizedIndex = _record.oversizedIndex;
+            m_oversized.removeLast();
+            _record.oversizedIndex = InvalidSlot;
+            return;
+        }
+
+        UInt32 entry = _record.firstEntry;
+        while (entry != InvalidSlot)
+        {
+            Entry & e = m_entries[entry];
+            if (e.prev != InvalidSlot)
+                m_entries[e.prev].next = e.next;
+            else
+                m_cells[e.cell].first = e.next;
+            if (e.next != InvalidSlot)
+                m_entries[e.next].prev = e.prev;
+            if (m_cells[e.cell].first == InvalidSlot)
+                removeCell(e.cell);
+
+            UInt32 next = e.nextOfEntity;
+            e.next = m_freeEntry;
+            m_freeEntry = entry;
+            entry = next;
+        }
+        _record.firstEntry = InvalidSlot;
+    }
+
+    bool SpatialIndex::overlaps(const AABB & _a, const AABB & _b)
+    {
+        for (Size i = 0; i < 3; ++i)
+        {
+            if (_a.max[i] < _b.min[i] || _a.min[i] > _b.max[i])
+                return false;
+        }
+        return true;
+    }
+}
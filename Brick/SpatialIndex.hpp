@@ -0,0 +1,243 @@
+#ifndef BRICK_SPATIALINDEX_HPP
+#define BRICK_SPATIALINDEX_HPP
+
+#include <Brick/ComponentObserver.hpp>
+#include <Stick/DynamicArray.hpp>
+
+#include <type_traits>
+#include <utility>
+
+namespace brick
+{
+    struct AABB
+    {
+        stick::Float32 min[3];
+        stick::Float32 max[3];
+    };
+
+    // Tells a SpatialIndex where a component is. Points with x, y and z members are
+    // supported out of the box, specialize it for other component types:
+    //
+    // template<>
+    // struct SpatialTrait<Sphere>
+    // {
+    //     static constexpr bool IsSpatial = true;
+    //
+    //     static AABB bounds(const Sphere & _sphere);
+    // };
+    template<class T, class Enable = void>
+    struct SpatialTrait
+    {
+        static constexpr bool IsSpatial = false;
+    };
+
+    template<class T>
+    struct SpatialTrait<T, typename std::enable_if<
+        std::is_arithmetic<decltype(std::declval<const T &>().x)>::value &&
+        std::is_arithmetic<decltype(std::declval<const T &>().y)>::value &&
+        std::is_arithmetic<decltype(std::declval<const T &>().z)>::value>::type>
+    {
+        static constexpr bool IsSpatial = true;
+
+        static AABB bounds(const T & _value)
+        {
+            stick::Float32 x = static_cast<stick::Float32>(_value.x);
+            stick::Float32 y = static_cast<stick::Float32>(_value.y);
+            stick::Float32 z = static_cast<stick::Float32>(_value.z);
+            return {{x, y, z}, {x, y, z}};
+        }
+    };
+
+    // Uniform grid of the bounds of the entities, see Hub::enableSpatialIndex(). The cells
+    // are hashed and removed once they run empty, so only the cells that contain entities
+    // take memory. An entity is stored
+    // in all the cells its bounds overlap, entities that would span more than MaxEntityCells
+    // cells are kept in a separate list that every query tests. Moving an entity within its
+    // cells only updates its bounds.
+    class STICK_API SpatialIndex : public ComponentObserver
+    {
+    public:
+
+        static constexpr stick::Size MaxEntityCells = 64;
+
+
+        SpatialIndex(stick::Allocator & _alloc, stick::Float32 _cellSize);
+
+        SpatialIndex(const SpatialIndex &) = delete;
+
+        SpatialIndex & operator = (const SpatialIndex &) = delete;
+
+        // adds _entity or updates its bounds.
+        void insert(EntityID _entity, const AABB & _bounds);
+
+        void remove(EntityID _entity);
+
+        void clear();
+
+        // Calls _fn(EntityID) for every entity whose bounds overlap _bounds (boundaries
+        // included). Only visits the cells _bounds overlaps, or all cells that contain
+        // entities if there are fewer of them. Reports every entity once.
+        template<class F>
+        void query(const AABB & _bounds, F _fn) const;
+
+        bool contains(EntityID _entity) const;
+
+        // number of indexed entities
+        stick::Size count() const;
+
+        // number of cells that contain entities
+        stick::Size cellCount() const;
+
+        stick::Float32 cellSize() const;
+
+        void componentRemoved(EntityID _entity);
+
+        void componentsReset();
+
+    private:
+
+        static constexpr stick::UInt32 InvalidSlot = static_cast<stick::UInt32>(-1);
+
+        struct CellCoord
+        {
+            stick::Int32 v[3];
+        };
+
+        struct Cell
+        {
+            CellCoord coord;
+            stick::UInt32 first;
+        };
+
+        // the membership of an entity in one cell
+        struct Entry
+        {
+            EntityID entity;
+            stick::UInt32 cell;
+            stick::UInt32 prev;
+            stick::UInt32 next;
+            stick::UInt32 nextOfEntity;
+        };
+
+        struct Record
+        {
+            AABB bounds;
+            CellCoord min;
+            CellCoord max;
+            // first entry of the entity, InvalidSlot if it is not indexed
+            stick::UInt32 firstEntry;
+            // position in m_oversized, InvalidSlot if the entity is in the cells
+            stick::UInt32 oversizedIndex;
+        };
+
+        CellCoord cellCoord(const stick::Float32 * _position) const;
+
+        stick::UInt32 findCell(const CellCoord & _coord) const;
+
+        stick::UInt32 ensureCell(const CellCoord & _coord);
+
+        // the slot of m_table that refers to _cell
+        stick::Size tableSlot(stick::UInt32 _cell) const;
+
+        void removeCell(stick::UInt32 _cell);
+
+        void growTable();
+
+        void unlink(Record & _record);
+
+        static bool overlaps(const AABB & _a, const AABB & _b);
+
+        template<class F>
+        void visitCell(stick::UInt32 _cell, const CellCoord & _queryMin, const AABB & _bounds, F & _fn) const;
+
+        stick::Float32 m_cellSize;
+        stick::Float32 m_invCellSize;
+        stick::DynamicArray<Cell> m_cells;
+        // open addressing table of cell index + 1, 0 marks a free slot
+        stick::DynamicArray<stick::UInt32> m_table;
+        stick::DynamicArray<Entry> m_entries;
+        stick::UInt32 m_freeEntry;
+        // indexed by entity id
+        stick::DynamicArray<Record> m_records;
+        stick::DynamicArray<EntityID> m_oversized;
+        stick::Size m_count;
+    };
+
+    // Feeds a SpatialIndex with the components T through SpatialTrait<T>.
+    template<class T>
+    class SpatialIndexT : public SpatialIndex
+    {
+    public:
+
+        static_assert(SpatialTrait<T>::IsSpatial, "SpatialTrait needs to be specialized for this component type");
+
+        using SpatialIndex::SpatialIndex;
+
+        void componentSet(EntityID _entity, const void * _value)
+        {
+            insert(_entity, SpatialTrait<T>::bounds(*static_cast<const T *>(_value)));
+        }
+    };
+
+    template<class F>
+    void SpatialIndex::query(const AABB & _bounds, F _fn) const
+    {
+        CellCoord qmin = cellCoord(_bounds.min);
+        CellCoord qmax = cellCoord(_bounds.max);
+        stick::Float64 volume = 1.0;
+        for (stick::Size i = 0; i < 3; ++i)
+            volume *= static_cast<stick::Float64>(qmax.v[i]) - qmin.v[i] + 1.0;
+
+        if (volume <= static_cast<stick::Float64>(m_cells.count()))
+        {
+            CellCoord c;
+            for (c.v[0] = qmin.v[0]; c.v[0] <= qmax.v[0]; ++c.v[0])
+            {
+                for (c.v[1] = qmin.v[1]; c.v[1] <= qmax.v[1]; ++c.v[1])
+                {
+                    for (c.v[2] = qmin.v[2]; c.v[2] <= qmax.v[2]; ++c.v[2])
+                    {
+                        stick::UInt32 cell = findCell(c);
+                        if (cell != InvalidSlot)
+                            visitCell(cell, qmin, _bounds, _fn);
+                    }
+                }
+            }
+        }
+        else
+        {
+            for (stick::UInt32 i = 0; i < m_cells.count(); ++i)
+            {
+                const CellCoord & c = m_cells[i].coord;
+                if (c.v[0] >= qmin.v[0] && c.v[0] <= qmax.v[0] &&
+                        c.v[1] >= qmin.v[1] && c.v[1] <= qmax.v[1] &&
+                        c.v[2] >= qmin.v[2] && c.v[2] <= qmax.v[2])
+                    visitCell(i, qmin, _bounds, _fn);
+            }
+        }
+
+        for (EntityID e : m_oversized)
+        {
+            if (overlaps(m_records[e].bounds, _bounds))
+                _fn(e);
+        }
+    }
+
+    template<class F>
+    void SpatialIndex::visitCell(stick::UInt32 _cell, const CellCoord & _queryMin, const AABB & _bounds, F & _fn) const
+    {
+        const CellCoord & c = m_cells[_cell].coord;
+        for (stick::UInt32 i = m_cells[_cell].first; i != InvalidSlot; i = m_entries[i].next)
+        {
+            const Record & r = m_records[m_entries[i].entity];
+            //an entity that spans several cells is only reported by the first of them the query overlaps
+            bool bFirst = true;
+            for (stick::Size j = 0; j < 3; ++j)
+                bFirst = bFirst && c.v[j] == (r.min.v[j] > _queryMin.v[j] ? r.min.v[j] : _queryMin.v[j]);
+            if (bFirst && overlaps(r.bounds, _bounds))
+                _fn(m_entries[i].entity);
+        }
+    }
+}
+
+#endif //BRICK_SPATIALINDEX_HPP
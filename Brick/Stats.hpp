@@ -0,0 +1,62 @@
+#ifndef BRICK_STATS_HPP
+#define BRICK_STATS_HPP
+
+#include <Stick/DynamicArray.hpp>
+
+namespace brick
+{
+    // Memory statistics of the storage of one component type, see Hub::stats().
+    struct ComponentStats
+    {
+        const char * name;
+        stick::UInt64 hash;
+        stick::Size componentID;
+        // number of components stored
+        stick::Size count;
+        // number of components the allocated pages can hold
+        stick::Size capacity;
+        // number of entity ids the sparse index can address
+        stick::Size sparseCount;
+        stick::Size valueSize;
+        // bytes of component values, packed entity ids and sparse slots in use
+        stick::Size bytesUsed;
+        // bytes of unused page slots, unused array capacity and sparse slots that
+        // don't point at a component
+        stick::Size bytesWasted;
+    };
+
+    // Only counted if Brick is built with BRICK_ENABLE_COUNTERS (the BrickCounters option,
+    // see Config.hpp), zero otherwise.
+    struct HubCounters
+    {
+        stick::Size createdEntities;
+        stick::Size destroyedEntities;
+        stick::Size setComponents;
+        stick::Size removedComponents;
+        // number of entities stepped over by view iterators
+        stick::Size viewIterations;
+    };
+
+    struct HubStats
+    {
+        HubStats(stick::Allocator & _alloc = stick::defaultAllocator()) :
+            components(_alloc)
+        {
+        }
+
+        stick::DynamicArray<ComponentStats> components;
+        stick::Size entityCount;
+        stick::Size freeListCount;
+        // the highest number of entity ids in use at the same time since the last compact()/shrinkToFit()/clear()
+        stick::Size entityHighWaterMark;
+        // bytes reserved for the per entity component bitsets
+        stick::Size bitsetBytes;
+        // bytes reserved for the handle versions, entity types and the free list
+        stick::Size entityBytes;
+        // bytes the arena of the hub requested from the hub's allocator
+        stick::Size arenaReservedBytes;
+        HubCounters counters;
+    };
+}
+
+#endif //BRICK_STATS_HPP
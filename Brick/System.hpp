@@ -0,0 +1,129 @@
+#ifndef BRICK_SYSTEM_HPP
+#define BRICK_SYSTEM_HPP
+
+#include <Brick/Hub.hpp>
+
+#include <functional>
+
+namespace brick
+{
+    // Access declarations used as template arguments of System, i.e.
+    // System<Read<Velocity>, Write<Position>>.
+    template<class...Components>
+    struct Read {};
+
+    template<class...Components>
+    struct Write {};
+
+    // A system that conflicts with every other system. Use this for systems
+    // that create/destroy entities or otherwise structurally change the hub.
+    struct Exclusive {};
+
+    struct STICK_API SystemAccess
+    {
+        SystemAccess() :
+            exclusive(false)
+        {
+        }
+
+        bool conflictsWith(const SystemAccess & _other) const
+        {
+            if (exclusive || _other.exclusive)
+                return true;
+            return (write & (_other.read | _other.write)).any() || (_other.write & read).any();
+        }
+
+        Hub::ComponentBitset read;
+        Hub::ComponentBitset write;
+        bool exclusive;
+    };
+
+    namespace detail
+    {
+        template<class A>
+        struct AccessTraits;
+
+        template<class...Components>
+        struct AccessTraits<Read<Components...>>
+        {
+            static void apply(const Hub & _hub, SystemAccess & _access)
+            {
+                int dummy[] = {0, (_access.read |= _hub.template componentMask<Components>(), 0)...};
+                (void)dummy;
+            }
+        };
+
+        template<class...Components>
+        struct AccessTraits<Write<Components...>>
+        {
+            static void apply(const Hub & _hub, SystemAccess & _access)
+            {
+                int dummy[] = {0, (_access.write |= _hub.template componentMask<Components>(), 0)...};
+                (void)dummy;
+            }
+        };
+
+        template<>
+        struct AccessTraits<Exclusive>
+        {
+            static void apply(const Hub &, SystemAccess & _access)
+            {
+                _access.exclusive = true;
+            }
+        };
+    }
+
+    class STICK_API SystemBase
+    {
+    public:
+
+        virtual ~SystemBase()
+        {
+        }
+
+        virtual void run(Hub & _hub) = 0;
+
+        virtual SystemAccess access(const Hub & _hub) const = 0;
+    };
+
+    // Base class for systems that declare which components they read and write.
+    // The Scheduler uses these declarations to run non conflicting systems concurrently.
+    template<class...Access>
+    class System : public SystemBase
+    {
+    public:
+
+        SystemAccess access(const Hub & _hub) const
+        {
+            SystemAccess ret;
+            int dummy[] = {0, (detail::AccessTraits<Access>::apply(_hub, ret), 0)...};
+            (void)dummy;
+            return ret;
+        }
+    };
+
+    template<class...Access>
+    class FunctionSystem : public System<Access...>
+    {
+    public:
+
+        using Function = std::function<void(Hub &)>;
+
+
+        FunctionSystem(Function _fn) :
+            m_fn(std::move(_fn))
+        {
+        }
+
+        void run(Hub & _hub)
+        {
+            m_fn(_hub);
+        }
+
+    private:
+
+        Function m_fn;
+    };
+}
+
+#endif //BRICK_SYSTEM_HPP
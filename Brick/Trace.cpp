@@ -0,0 +1,97 @@
+#include <Brick/Trace.hpp>
+
+#include <atomic>
+#include <chrono>
+
+namespace brick
+{
+    using namespace stick;
+
+    namespace
+    {
+        std::atomic<TraceSink *> s_sink(nullptr);
+        std::atomic<UInt32> s_nextThreadID(0);
+    }
+
+    ChromeTraceSink::ChromeTraceSink(const char * _path) :
+        m_file(std::fopen(_path, "w")),
+        m_bFirstEvent(true)
+    {
+        if (m_file)
+            std::fputs("{\"traceEvents\":[\n", m_file);
+    }
+
+    ChromeTraceSink::~ChromeTraceSink()
+    {
+        close();
+    }
+
+    void ChromeTraceSink::event(const char * _name, UInt64 _beginNs, UInt64 _endNs, UInt32 _threadID)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file)
+            return;
+
+        std::fputs(m_bFirstEvent ? "{\"name\":\"" : ",\n{\"name\":\"", m_file);
+        m_bFirstEvent = false;
+        for (const char * c = _name; *c; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+                std::fputc('\\', m_file);
+            std::fputc(*c, m_file);
+        }
+        //chrome expects microseconds
+        std::fprintf(m_file, "\",\"cat\":\"brick\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u}",
+                     _beginNs / 1000.0, (_endNs - _beginNs) / 1000.0, (unsigned)_threadID);
+    }
+
+    bool ChromeTraceSink::isOpen() const
+    {
+        return m_file != nullptr;
+    }
+
+    void ChromeTraceSink::close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_file)
+            return;
+        std::fputs("\n]}\n", m_file);
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+
+    void setTraceSink(TraceSink * _sink)
+    {
+        s_sink.store(_sink, std::memory_order_release);
+    }
+
+    TraceSink * traceSink()
+    {
+        return s_sink.load(std::memory_order_acquire);
+    }
+
+    UInt64 traceTimestamp()
+    {
+        using namespace std::chrono;
+        return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    UInt32 traceThreadID()
+    {
+        static thread_local UInt32 s_id = s_nextThreadID++;
+        return s_id;
+    }
+
+    TraceScope::TraceScope(const char * _name) :
+        m_name(_name),
+        m_sink(traceSink()),
+        m_begin(m_sink ? traceTimestamp() : 0)
+    {
+    }
+
+    TraceScope::~TraceScope()
+    {
+        if (m_sink)
+            m_sink->event(m_name, m_begin, traceTimestamp(), traceThreadID());
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef BRICK_TRACE_HPP
+#define BRICK_TRACE_HPP
+
+#include <Brick/Config.hpp>
+#include <Stick/Platform.hpp>
+
+#include <cstdio>
+#include <mutex>
+
+namespace brick
+{
+    // Receives the scoped events emitted by the BRICK_TRACE_SCOPE hooks. Events can
+    // arrive from any thread. Timestamps are in nanoseconds relative to an arbitrary
+    // but fixed point in time.
+    class STICK_API TraceSink
+    {
+    public:
+
+        virtual ~TraceSink()
+        {
+        }
+
+        virtual void event(const char * _name, stick::UInt64 _beginNs, stick::UInt64 _endNs, stick::UInt32 _threadID) = 0;
+    };
+
+    // Writes the events in the Chrome trace-event JSON format, open the file in
+    // chrome://tracing or https://ui.perfetto.dev.
+    class STICK_API ChromeTraceSink : public TraceSink
+    {
+    public:
+
+        ChromeTraceSink(const char * _path);
+
+        ~ChromeTraceSink();
+
+        ChromeTraceSink(const ChromeTraceSink &) = delete;
+
+        ChromeTraceSink & operator = (const ChromeTraceSink &) = delete;
+
+        void event(const char * _name, stick::UInt64 _beginNs, stick::UInt64 _endNs, stick::UInt32 _threadID);
+
+        bool isOpen() const;
+
+        // writes the closing bracket and closes the file, called by the destructor.
+        void close();
+
+    private:
+
+        std::FILE * m_file;
+        bool m_bFirstEvent;
+        std::mutex m_mutex;
+    };
+
+    // The sink is not owned, pass nullptr to disable tracing at runtime.
+    STICK_API void setTraceSink(TraceSink * _sink);
+
+    STICK_API TraceSink * traceSink();
+
+    STICK_API stick::UInt64 traceTimestamp();
+
+    // small sequential id of the calling thread
+    STICK_API stick::UInt32 traceThreadID();
+
+    // Emits an event spanning its lifetime to the current sink.
+    class STICK_API TraceScope
+    {
+    public:
+
+        TraceScope(const char * _name);
+
+        ~TraceScope();
+
+        TraceScope(const TraceScope &) = delete;
+
+        TraceScope & operator = (const TraceScope &) = delete;
+
+    private:
+
+        const char * m_name;
+        TraceSink * m_sink;
+        stick::UInt64 m_begin;
+    };
+}
+
+#define BRICK_TRACE_CONCAT_IMPL(a, b) a##b
+#define BRICK_TRACE_CONCAT(a, b) BRICK_TRACE_CONCAT_IMPL(a, b)
+
+// The hooks only exist if Brick is built with BRICK_ENABLE_TRACING (the BrickTracing
+// option, see Config.hpp), otherwise they compile to nothing. The hooks in the headers
+// follow the same setting, as it comes from the installed config header rather than
+// the compile definitions of the including code.
+#ifdef BRICK_ENABLE_TRACING
+#define BRICK_TRACE_SCOPE(_name) brick::TraceScope BRICK_TRACE_CONCAT(brickTraceScope, __LINE__)(_name)
+#else
+#define BRICK_TRACE_SCOPE(_name) do {} while (false)
+#endif
+
+#endif //BRICK_TRACE_HPP
@@ -7,43 +7,29 @@
 
 namespace brick
 {
-    namespace detail
-    {
-        using EntityTypeHolder = Component<ComponentName("EntityTypeHolder"), stick::TypeID>;
-    }
-
+    // Entity handle for entities created through createEntity<T>(). The type of
+    // the entity is stored in the hub, see Entity::entityType().
     class STICK_API TypedEntity : public Entity
     {
-    public:
-
-        stick::TypeID entityType()
-        {
-            if (hasComponent<detail::EntityTypeHolder>())
-                return get<detail::EntityTypeHolder>();
-            return 0;
-        }
     };
 
-    template<class RefCounter = detail::SimpleRefCounter>
-    class STICK_API SharedTypedEntityT : public SharedEntity<RefCounter>
+    template<class RefCounter = detail::SimpleRefCounter, class ReleasePolicy = detail::ImmediateRelease>
+    class STICK_API SharedTypedEntityT : public SharedEntity<RefCounter, ReleasePolicy>
     {
-    public:
-        
-        stick::TypeID entityType()
-        {
-            if (SharedEntity<RefCounter>::template hasComponent<detail::EntityTypeHolder>())
-                return SharedEntity<RefCounter>::template get<detail::EntityTypeHolder>();
-            return 0;
-        }
     };
 
     using SharedTypedEntity = SharedTypedEntityT<>;
 
+    // releases its entity through Hub::collectGarbage() instead of destroying it right away.
+    using DeferredSharedTypedEntity = SharedTypedEntityT<detail::SimpleRefCounter, detail::DeferredRelease>;
+
+    // releases its entity through Hub::collectGarbage(), so it can be dropped on any thread.
+    using AtomicSharedTypedEntity = SharedTypedEntityT<detail::AtomicRefCounter, detail::DeferredRelease>;
+
     template<class T>
     T entityCast(const Entity & _e)
     {
-        auto maybe = _e.maybe<detail::EntityTypeHolder>();
-        if (maybe && (*maybe) == stick::TypeInfoT<T>::typeID())
+        if (_e.isValid() && _e.entityType() == stick::TypeInfoT<T>::typeID())
         {
             T ret;
             ret.assignEntity(_e);
@@ -65,7 +51,7 @@ namespace brick
     {
         T ret;
         ret.assignEntity(_h.createEntity(), _args...);
-        ret.template set<detail::EntityTypeHolder>(stick::TypeInfoT<T>::typeID());
+        ret.setEntityType(stick::TypeInfoT<T>::typeID());
         return ret;
     }
 }
@@ -3,8 +3,17 @@
 #include <Brick/Component.hpp>
 #include <Brick/Hub.hpp>
 #include <Brick/SharedEntity.hpp>
+#include <Brick/Scheduler.hpp>
+#include <Brick/Trace.hpp>
 #include <Stick/Test.hpp>
 
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 using namespace stick;
@@ -37,6 +46,166 @@ struct C : public SharedTypedEntity
 {
 };
 
+struct RecordingTraceSink : public TraceSink
+{
+    void event(const char * _name, UInt64 _beginNs, UInt64 _endNs, UInt32)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        names.push_back(_name);
+        bOrdered = bOrdered && _beginNs <= _endNs;
+    }
+
+    Size count(const char * _name) const
+    {
+        Size ret = 0;
+        for (const String & n : names)
+            ret += n == _name;
+        return ret;
+    }
+
+    std::vector<String> names;
+    bool bOrdered = true;
+    std::mutex mutex;
+};
+
+struct CountingAllocator : public Allocator
+{
+    CountingAllocator() :
+        allocationCount(0),
+        deallocationCount(0)
+    {
+    }
+
+    Block allocate(Size _byteCount, Size _alignment)
+    {
+        allocationCount++;
+        return defaultAllocator().allocate(_byteCount, _alignment);
+    }
+
+    Block reallocate(const Block & _block, Size _byteCount, Size _alignment)
+    {
+        allocationCount++;
+        return defaultAllocator().reallocate(_block, _byteCount, _alignment);
+    }
+
+    void deallocate(const Block & _block)
+    {
+        deallocationCount++;
+        defaultAllocator().deallocate(_block);
+    }
+
+    Size allocationCount;
+    Size deallocationCount;
+};
+
+// owns a heap block, copies allocate, moves don't
+struct HeapBuffer
+{
+    HeapBuffer(Allocator & _alloc, Size _byteCount) :
+        alloc(&_alloc),
+        block(_alloc.allocate(_byteCount, 8))
+    {
+    }
+
+    HeapBuffer(const HeapBuffer & _other) :
+        alloc(_other.alloc),
+        block(_other.alloc->allocate(_other.block.byteCount, 8))
+    {
+        std::memcpy(block.ptr, _other.block.ptr, block.byteCount);
+    }
+
+    HeapBuffer(HeapBuffer && _other) :
+        alloc(_other.alloc),
+        block(_other.block)
+    {
+        _other.block = {nullptr, 0};
+    }
+
+    ~HeapBuffer()
+    {
+        if (block.ptr)
+            alloc->deallocate(block);
+    }
+
+    HeapBuffer & operator = (const HeapBuffer & _other)
+    {
+        HeapBuffer tmp(_other);
+        return *this = std::move(tmp);
+    }
+
+    HeapBuffer & operator = (HeapBuffer && _other)
+    {
+        if (block.ptr)
+            alloc->deallocate(block);
+        alloc = _other.alloc;
+        block = _other.block;
+        _other.block = {nullptr, 0};
+        return *this;
+    }
+
+    Allocator * alloc;
+    Block block;
+};
+
+// move only, but can be cloned through its CloneTrait
+struct MeshData
+{
+    explicit MeshData(Size _vertexCount = 0) :
+        vertices(new Float32[_vertexCount]()),
+        vertexCount(_vertexCount)
+    {
+    }
+
+    MeshData(MeshData &&) = default;
+
+    MeshData & operator = (MeshData &&) = default;
+
+    std::unique_ptr<Float32[]> vertices;
+    Size vertexCount;
+};
+
+struct Box
+{
+    Float32 min[3];
+    Float32 max[3];
+};
+
+namespace brick
+{
+    template<>
+    struct SpatialTrait<Box>
+    {
+        static constexpr bool IsSpatial = true;
+
+        static AABB bounds(const Box & _box)
+        {
+            return {{_box.min[0], _box.min[1], _box.min[2]}, {_box.max[0], _box.max[1], _box.max[2]}};
+        }
+    };
+
+    template<>
+    struct CloneTrait<MeshData>
+    {
+        static constexpr bool IsClonable = true;
+
+        static MeshData clone(const MeshData & _mesh)
+        {
+            MeshData ret(_mesh.vertexCount);
+            std::memcpy(ret.vertices.get(), _mesh.vertices.get(), sizeof(Float32) * _mesh.vertexCount);
+            return ret;
+        }
+    };
+}
+
+template<class R>
+Size countEntities(R _range)
+{
+    Size ret = 0;
+    for (auto it = _range.begin(); it != _range.end(); ++it)
+        ++ret;
+    return ret;
+}
+
 const Suite spec[] =
 {
     SUITE("Basic Tests")
@@ -182,6 +351,49 @@ const Suite spec[] =
         EXPECT(e.hub() == c.hub());
         EXPECT(e.id() == c.id());
         EXPECT(e.version() == c.version());
+
+        //the type lives in the hub, not in a component
+        EXPECT(a.entityType() == TypeInfoT<A>::typeID());
+        EXPECT(b.entityType() == TypeInfoT<B>::typeID());
+        EXPECT(hub.createEntity().entityType() == 0);
+
+        A a2 = createEntity<A>(hub);
+        A a3 = createEntity<A>(hub);
+        createEntity<B>(hub);
+        Size count = 0;
+        for (A ae : hub.viewOfType<A>())
+        {
+            EXPECT(ae.entityType() == TypeInfoT<A>::typeID());
+            ++count;
+        }
+        EXPECT(count == 3);
+
+        //clones keep the type, destroyed entities lose it
+        Entity cl = a2.clone();
+        EXPECT(entityCast<A>(cl));
+        a3.destroy();
+        Entity reused = hub.createEntity();
+        EXPECT(reused.entityType() == 0);
+        EXPECT(!entityCast<A>(reused));
+        count = 0;
+        for (A ae : hub.viewOfType<A>())
+            ++count;
+        EXPECT(count == 3);
+
+        //compaction moves the types along with the entities
+        b.destroy();
+        hub.compact();
+        count = 0;
+        for (A ae : hub.viewOfType<A>())
+        {
+            EXPECT(ae.isValid());
+            ++count;
+        }
+        EXPECT(count == 3);
+        count = 0;
+        for (B be : hub.viewOfType<B>())
+            ++count;
+        EXPECT(count == 1);
     },
     SUITE("SharedEntity Tests")
     {
@@ -231,6 +443,131 @@ const Suite spec[] =
         EXPECT(tent3.referenceCount() == 6);
         EXPECT(tent3.isValid());
         EXPECT(!tent2.isValid());
+
+        //cloning does not share the ref counter
+        Entity cl = tent3.clone();
+        SharedTypedEntity tent4 = reinterpretEntity<SharedTypedEntity>(cl);
+        EXPECT(tent4.referenceCount() == 1);
+        EXPECT(tent3.referenceCount() == 6);
+
+        //the last reference destroys the entity
+        array.clear();
+        Size count = hub.entityCount();
+        tent3 = SharedTypedEntity();
+        EXPECT(hub.entityCount() == count - 1);
+    },
+    SUITE("Atomic SharedEntity Tests")
+    {
+        Hub hub;
+        auto ent = createEntity<AtomicSharedTypedEntity>(hub);
+        EXPECT(ent.referenceCount() == 1);
+        EXPECT(hub.entityCount() == 1);
+
+        std::vector<std::thread> threads;
+        std::atomic<Size> maxCount(0);
+        for (Size i = 0; i < 4; ++i)
+        {
+            threads.push_back(std::thread([&]()
+            {
+                DynamicArray<AtomicSharedTypedEntity> copies;
+                for (Size j = 0; j < 1000; ++j)
+                    copies.append(ent);
+                Size c = ent.referenceCount();
+                Size m = maxCount;
+                while (c > m && !maxCount.compare_exchange_weak(m, c)) {}
+                for (Size j = 0; j < 500; ++j)
+                    copies.removeLast();
+            }));
+        }
+        for (auto & t : threads)
+            t.join();
+
+        EXPECT(maxCount >= 1001);
+        EXPECT(ent.referenceCount() == 1);
+        EXPECT(hub.entityCount() == 1);
+        ent.invalidate();
+        //atomic shared entities are released by collectGarbage()
+        EXPECT(hub.entityCount() == 1);
+        EXPECT(hub.queuedDestroyCount() == 1);
+        EXPECT(hub.collectGarbage() == 1);
+        EXPECT(hub.entityCount() == 0);
+    },
+    SUITE("Deferred Release Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+        using Owned = Component<ComponentName("Owned"), DeferredSharedTypedEntity>;
+
+        Hub hub;
+        {
+            DynamicArray<DeferredSharedTypedEntity> entities;
+            for (Size i = 0; i < 100; ++i)
+            {
+                entities.append(createEntity<DeferredSharedTypedEntity>(hub));
+                entities.last().set<Position>(1.0f, 2.0f, (Float32)i);
+                if (i % 2)
+                    entities.last().set<Name>("a");
+            }
+            EXPECT(entities[0].referenceCount() == 1);
+            EXPECT(hub.entityCount() == 100);
+            entities.clear();
+            EXPECT(hub.entityCount() == 100);
+            EXPECT(hub.queuedDestroyCount() == 100);
+        }
+        EXPECT(hub.collectGarbage() == 100);
+        EXPECT(hub.entityCount() == 0);
+        EXPECT(hub.queuedDestroyCount() == 0);
+        EXPECT(hub.collectGarbage() == 0);
+
+        //entities destroyed before collecting are skipped
+        auto a = createEntity<DeferredSharedTypedEntity>(hub);
+        Entity plain = a;
+        a.invalidate();
+        plain.destroy();
+        EXPECT(hub.collectGarbage() == 0);
+        EXPECT(hub.entityCount() == 0);
+
+        //releasing the last handle of an entity that was destroyed by other means
+        //just frees the counter
+        {
+            auto b = createEntity<DeferredSharedTypedEntity>(hub);
+            auto c = b;
+            Entity(b).destroy();
+            EXPECT(!c.isValid());
+            EXPECT(c.referenceCount() == 2);
+        }
+        EXPECT(hub.collectGarbage() == 0);
+
+        //releases caused by destroying the queued entities are collected in the same pass
+        {
+            auto parent = createEntity<DeferredSharedTypedEntity>(hub);
+            auto child = createEntity<DeferredSharedTypedEntity>(hub);
+            parent.set<Owned>(child);
+            EXPECT(child.referenceCount() == 2);
+        }
+        EXPECT(hub.entityCount() == 2);
+        EXPECT(hub.queuedDestroyCount() == 1);
+        EXPECT(hub.collectGarbage() == 2);
+        EXPECT(hub.entityCount() == 0);
+
+        //releasing from multiple threads
+        DynamicArray<AtomicSharedTypedEntity> shared;
+        for (Size i = 0; i < 64; ++i)
+            shared.append(createEntity<AtomicSharedTypedEntity>(hub));
+        std::vector<std::thread> threads;
+        for (Size i = 0; i < 4; ++i)
+        {
+            threads.push_back(std::thread([&, i]()
+            {
+                for (Size j = i; j < shared.count(); j += 4)
+                    shared[j].invalidate();
+            }));
+        }
+        for (auto & t : threads)
+            t.join();
+        EXPECT(hub.entityCount() == 64);
+        EXPECT(hub.collectGarbage() == 64);
+        EXPECT(hub.entityCount() == 0);
     },
     SUITE("Reserve Tests")
     {
@@ -273,6 +610,1950 @@ const Suite spec[] =
 
         a.destroy();
         c.destroy();
+    },
+    SUITE("Allocator Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+
+        {
+            CountingAllocator counter;
+            PagedArena arena(counter, 1024);
+            Block a = arena.allocate(100, 8);
+            Block b = arena.allocate(100, 16);
+            EXPECT(a.ptr && b.ptr);
+            EXPECT(reinterpret_cast<std::uintptr_t>(b.ptr) % 16 == 0);
+            EXPECT(arena.pageCount() == 1);
+            //growing the last allocation happens in place
+            Block d = arena.reallocate(b, 200, 16);
+            EXPECT(d.ptr == b.ptr);
+            //bigger than a page
+            Block c = arena.allocate(4000, 8);
+            EXPECT(c.ptr);
+            EXPECT(arena.pageCount() == 2);
+            EXPECT(counter.allocationCount == 2);
+            arena.reset();
+            arena.allocate(100, 8);
+            arena.allocate(4000, 8);
+            EXPECT(counter.allocationCount == 2);
+            arena.release();
+            EXPECT(counter.deallocationCount == 2);
+        }
+
+        {
+            CountingAllocator counter;
+            PoolAllocator pool(counter, 24, 8, 4, 4);
+            DynamicArray<Block> blocks;
+            for (Size i = 0; i < 8; ++i)
+                blocks.append(pool.allocate(24, 8));
+            EXPECT(pool.chunkCount() == 2);
+            EXPECT(counter.allocationCount == 2);
+            for (auto & b : blocks)
+                pool.deallocate(b);
+            EXPECT(pool.freeBlockCount() == 8);
+            for (Size i = 0; i < 8; ++i)
+                pool.allocate(24, 8);
+            EXPECT(counter.allocationCount == 2);
+        }
+
+        {
+            //chunks start small and double up to the maximum
+            CountingAllocator counter;
+            PoolAllocator pool(counter, 64, 8, 1, 4);
+            pool.allocate(64, 8);
+            EXPECT(pool.chunkCount() == 1);
+            EXPECT(pool.freeBlockCount() == 0);
+            for (Size i = 0; i < 14; ++i)
+                pool.allocate(64, 8);
+            //1 + 2 + 4 + 4 + 4 blocks
+            EXPECT(pool.chunkCount() == 5);
+            EXPECT(pool.freeBlockCount() == 0);
+            pool.release();
+            pool.allocate(64, 8);
+            EXPECT(pool.freeBlockCount() == 0);
+        }
+
+        CountingAllocator counter;
+        {
+            Hub hub(counter, 4096);
+            Entity first;
+            for (Size i = 0; i < 1000; ++i)
+            {
+                Entity e = hub.createEntity();
+                e.set<Position>(1.0f, 2.0f, 3.0f);
+                if (i % 3 == 0)
+                    e.set<Name>("Some pretty long name that is not stored inline");
+                if (!first)
+                    first = e;
+            }
+            EXPECT(hub.entityCount() == 1000);
+            Size pages = hub.arena().pageCount();
+            Size allocs = counter.allocationCount;
+
+            hub.clear();
+            EXPECT(hub.entityCount() == 0);
+            EXPECT(!first.isValid());
+            EXPECT(hub.arena().pageCount() == pages);
+
+            //rebuilding the same world reuses the arena pages
+            for (Size i = 0; i < 1000; ++i)
+            {
+                Entity e = hub.createEntity();
+                e.set<Position>(3.0f, 2.0f, 1.0f);
+                if (i % 3 == 0)
+                    e.set<Name>("Some pretty long name that is not stored inline");
+            }
+            EXPECT(hub.entityCount() == 1000);
+            EXPECT(!first.isValid());
+            Size posCount = 0;
+            for (Entity e : hub.view<Position>())
+            {
+                EXPECT(e.get<Position>().x == 3.0f);
+                posCount++;
+            }
+            EXPECT(posCount == 1000);
+            EXPECT(counter.allocationCount - allocs <= 1);
+
+            hub.release();
+            EXPECT(hub.arena().pageCount() == 0);
+            Entity e = hub.createEntity();
+            e.set<Name>("Eggbert");
+            EXPECT(e.get<Name>() == "Eggbert");
+        }
+        EXPECT(counter.allocationCount == counter.deallocationCount);
+    },
+    SUITE("Compact Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+
+        Hub hub(defaultAllocator(), 4096);
+        DynamicArray<Entity> entities;
+        for (Size i = 0; i < 10000; ++i)
+        {
+            Entity e = hub.createEntity();
+            e.set<Position>((Float32)i, 0.0f, 0.0f);
+            if (i % 2 == 0)
+                e.set<Name>("Name that is long enough to be allocated");
+            entities.append(e);
+        }
+
+        DynamicArray<Entity> alive;
+        for (Size i = 0; i < entities.count(); ++i)
+        {
+            if (i % 4 != 0 || i > 5000)
+                entities[i].destroy();
+            else
+                alive.append(entities[i]);
+        }
+        EXPECT(hub.entityCount() == alive.count());
+        Size bytesBefore = hub.arena().reservedByteCount();
+
+        Entity first = alive[0];
+        Size remapCount = 0;
+        hub.compact([&](const Entity & _old, const Entity & _new)
+        {
+            auto it = find(alive.begin(), alive.end(), _old);
+            EXPECT(it != alive.end());
+            *it = _new;
+            remapCount++;
+        });
+        //the first entity stays where it is
+        EXPECT(remapCount == alive.count() - 1);
+        EXPECT(first.isValid());
+        EXPECT(hub.entityCount() == alive.count());
+        EXPECT(hub.arena().reservedByteCount() < bytesBefore);
+        for (Size i = 0; i < alive.count(); ++i)
+        {
+            EXPECT(alive[i].isValid());
+            EXPECT(alive[i].id() == i);
+            EXPECT(alive[i].get<Position>().x == (Float32)(i * 4));
+            EXPECT(alive[i].hasComponent<Name>());
+        }
+        //old handles stay invalid even though their ids are in use again
+        EXPECT(!entities[4].isValid());
+        EXPECT(!entities[5].isValid());
+
+        Size count = 0;
+        for (Entity e : hub)
+            count++;
+        EXPECT(count == alive.count());
+
+        //shrinkToFit only drops the free ids at the end
+        alive[10].destroy();
+        for (Size i = 50; i < alive.count(); ++i)
+            alive[i].destroy();
+        hub.shrinkToFit();
+        EXPECT(hub.entityCount() == 49);
+        EXPECT(alive[9].isValid());
+        EXPECT(alive[9].get<Position>().x == 36.0f);
+        EXPECT(alive[11].isValid());
+        EXPECT(!alive[10].isValid());
+        //the gap gets reused first, the trimmed ids get fresh versions
+        Entity a = hub.createEntity();
+        EXPECT(a.id() == 10);
+        EXPECT(!a.hasComponent<Position>());
+        Entity b = hub.createEntity();
+        EXPECT(b.id() == 50);
+        EXPECT(!alive[50].isValid());
+        b.set<Name>("Eggbert");
+        EXPECT(b.get<Name>() == "Eggbert");
+    },
+    SUITE("Sort Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Velocity = Component<ComponentName("Velocity"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+
+        Hub hub;
+        Float32 values[] = {5.0f, 3.0f, 9.0f, 1.0f, 7.0f, 2.0f, 8.0f, 0.0f, 4.0f, 6.0f};
+        for (Size i = 0; i < 10; ++i)
+        {
+            Entity e = hub.createEntity();
+            e.set<Position>(values[i], 0.0f, 0.0f);
+            e.set<Velocity>(values[i], 1.0f, 0.0f);
+            if (i % 2 == 0)
+                e.set<Name>("Eggbert");
+        }
+
+        hub.sort<Position>([](const Vec3f & _a, const Vec3f & _b) { return _a.x < _b.x; });
+        Float32 expected = 0.0f;
+        for (Entity e : hub.view<Position>())
+        {
+            EXPECT(e.get<Position>().x == expected);
+            expected += 1.0f;
+        }
+        EXPECT(expected == 10.0f);
+
+        //the velocity storage still has the creation order...
+        hub.sortByEntityOrder<Velocity, Position>();
+        expected = 0.0f;
+        for (Entity e : hub.view<Velocity>())
+        {
+            EXPECT(e.get<Velocity>().x == expected);
+            expected += 1.0f;
+        }
+        EXPECT(expected == 10.0f);
+
+        //sort descending and drag velocity along
+        hub.sort<Position, Velocity>([](const Vec3f & _a, const Vec3f & _b) { return _a.x > _b.x; });
+        expected = 9.0f;
+        for (Entity e : hub.view<Velocity, Position>())
+        {
+            EXPECT(e.get<Velocity>().x == expected);
+            EXPECT(e.get<Position>().x == expected);
+            expected -= 1.0f;
+        }
+
+        //names only exist on some entities, they follow the position order
+        hub.sortByEntityOrder<Name, Position>();
+        Float32 last = 10.0f;
+        Size count = 0;
+        for (Entity e : hub.view<Name, Position>())
+        {
+            EXPECT(e.get<Position>().x < last);
+            last = e.get<Position>().x;
+            count++;
+        }
+        EXPECT(count == 5);
+
+        //destroying the current entity while iterating visits every entity once
+        count = 0;
+        for (Entity e : hub.view<Position>())
+        {
+            if (e.get<Position>().x < 5.0f)
+                e.destroy();
+            count++;
+        }
+        EXPECT(count == 10);
+        EXPECT(hub.entityCount() == 5);
+        count = 0;
+        for (Entity e : hub.view<Position, Velocity>())
+        {
+            EXPECT(e.get<Position>().x >= 5.0f);
+            EXPECT(e.get<Position>().x == e.get<Velocity>().x);
+            count++;
+        }
+        EXPECT(count == 5);
+    },
+    SUITE("Hierarchy Tests")
+    {
+        using Local = Component<ComponentName("Local"), Vec3f>;
+        using World = Component<ComponentName("World"), Vec3f>;
+
+        Hub hub;
+        Entity root = hub.createEntity();
+        DynamicArray<Entity> all;
+        all.append(root);
+        //create children in an order that puts many of them before their parents
+        DynamicArray<Entity> level1, level2;
+        for (Size i = 0; i < 3; ++i)
+        {
+            for (Size j = 0; j < 3; ++j)
+                level2.append(hub.createEntity());
+            level1.append(hub.createEntity());
+        }
+        for (Size i = 0; i < 3; ++i)
+        {
+            level1[i].setParent(root);
+            for (Size j = 0; j < 3; ++j)
+                level2[i * 3 + j].setParent(level1[i]);
+        }
+        for (Entity e : level1)
+            all.append(e);
+        for (Entity e : level2)
+            all.append(e);
+        for (Entity e : all)
+        {
+            e.set<Local>(1.0f, 0.0f, 0.0f);
+            e.set<World>(0.0f, 0.0f, 0.0f);
+        }
+
+        EXPECT(level2[4].parent() == level1[1]);
+        EXPECT(level1[1].parent() == root);
+        EXPECT(!root.parent());
+        Size childCount = 0;
+        for (Entity c = root.firstChild(); c; c = c.nextSibling())
+            childCount++;
+        EXPECT(childCount == 3);
+        EXPECT(level2[4].get<Hierarchy>().depth == 2);
+
+        hub.sortHierarchy<Local, World>();
+        Size visited = 0;
+        for (Entity e : hub.view<Hierarchy, Local, World>())
+        {
+            Entity p = e.parent();
+            //parents are always visited first
+            e.get<World>().x = e.get<Local>().x + (p ? p.get<World>().x : 0.0f);
+            visited++;
+        }
+        EXPECT(visited == 13);
+        EXPECT(root.get<World>().x == 1.0f);
+        EXPECT(level1[2].get<World>().x == 2.0f);
+        EXPECT(level2[8].get<World>().x == 3.0f);
+
+        //breadth first: every level follows the order of the parents in the level above
+        DynamicArray<Entity> order;
+        for (Entity e : hub.view<Hierarchy>())
+            order.append(e);
+        auto position = [&](const Entity & _e)
+        {
+            Size i = 0;
+            while (order[i] != _e)
+                ++i;
+            return i;
+        };
+        for (Size i = 1; i < order.count(); ++i)
+        {
+            EXPECT(order[i].get<Hierarchy>().depth >= order[i - 1].get<Hierarchy>().depth);
+            if (order[i].parent() && order[i - 1].parent())
+                EXPECT(position(order[i].parent()) >= position(order[i - 1].parent()));
+        }
+
+        //reparenting updates the depth of the whole subtree
+        level1[0].setParent(level2[8]);
+        EXPECT(level1[0].get<Hierarchy>().depth == 3);
+        EXPECT(level2[0].get<Hierarchy>().depth == 4);
+        childCount = 0;
+        for (Entity c = root.firstChild(); c; c = c.nextSibling())
+            childCount++;
+        EXPECT(childCount == 2);
+
+        hub.sortHierarchy<Local, World>();
+        Size lastDepth = 0;
+        for (Entity e : hub.view<Hierarchy>())
+        {
+            EXPECT(e.get<Hierarchy>().depth >= lastDepth);
+            lastDepth = e.get<Hierarchy>().depth;
+        }
+        EXPECT(lastDepth == 4);
+
+        //destroying a parent makes its children roots
+        level1[1].destroy();
+        EXPECT(!level2[3].parent());
+        EXPECT(level2[3].get<Hierarchy>().depth == 0);
+        childCount = 0;
+        for (Entity c = root.firstChild(); c; c = c.nextSibling())
+            childCount++;
+        EXPECT(childCount == 1);
+
+        //compaction keeps the links intact
+        hub.compact([&](const Entity & _old, const Entity & _new)
+        {
+            for (Entity & e : level1)
+            {
+                if (e == _old)
+                    e = _new;
+            }
+            for (Entity & e : level2)
+            {
+                if (e == _old)
+                    e = _new;
+            }
+        });
+        EXPECT(level2[0].parent() == level1[0]);
+        EXPECT(level1[0].parent() == level2[8]);
+        EXPECT(level2[8].parent() == level1[2]);
+        EXPECT(level2[0].get<Hierarchy>().depth == 4);
+
+        //clones become siblings rather than copying the links
+        Entity clone = level2[0].clone();
+        EXPECT(clone.parent() == level1[0]);
+        EXPECT(!clone.firstChild());
+        EXPECT(level1[0].firstChild() == clone);
+        EXPECT(clone.nextSibling() == level2[2] || clone.nextSibling() == level2[1] || clone.nextSibling() == level2[0]);
+        childCount = 0;
+        for (Entity c = level1[0].firstChild(); c; c = c.nextSibling())
+            childCount++;
+        EXPECT(childCount == 4);
+
+        //removing the component detaches the entity like destroying it
+        level1[0].removeComponent<Hierarchy>();
+        EXPECT(!level2[0].parent());
+        EXPECT(!clone.parent());
+        EXPECT(!level2[8].firstChild());
+        EXPECT(clone.get<Hierarchy>().depth == 0);
+    },
+    SUITE("Emplace Tests")
+    {
+        using Buffer = Component<ComponentName("Buffer"), HeapBuffer>;
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+
+        CountingAllocator counter;
+        Hub hub;
+        Entity e = hub.createEntity();
+
+        //constructed in place, the only allocation is the buffer itself
+        HeapBuffer & b = e.emplace<Buffer>(counter, 64);
+        EXPECT(counter.allocationCount == 1);
+        EXPECT(b.block.byteCount == 64);
+        EXPECT(&e.get<Buffer>() == &b);
+
+        //moving a buffer in does not allocate and frees the old one
+        HeapBuffer other(counter, 32);
+        EXPECT(counter.allocationCount == 2);
+        e.set<Buffer>(std::move(other));
+        EXPECT(counter.allocationCount == 2);
+        EXPECT(e.get<Buffer>().block.byteCount == 32);
+        EXPECT(!other.block.ptr);
+        EXPECT(counter.deallocationCount == 1);
+
+        HeapBuffer third(counter, 16);
+        e.replace<Buffer>(std::move(third));
+        EXPECT(counter.allocationCount == 3);
+        EXPECT(e.get<Buffer>().block.byteCount == 16);
+
+        //copying allocates exactly once
+        HeapBuffer fourth(counter, 8);
+        e.set<Buffer>(fourth);
+        EXPECT(counter.allocationCount == 5);
+        EXPECT(e.get<Buffer>().block.byteCount == 8);
+
+        //setting a new entity from an rvalue moves it into the storage
+        Entity e2 = hub.createEntity();
+        e2.set<Buffer>(HeapBuffer(counter, 128));
+        EXPECT(counter.allocationCount == 6);
+
+        //aggregates and constructors still work
+        e.set<Position>(1.0f, 2.0f, 3.0f);
+        EXPECT(e.get<Position>().z == 3.0f);
+        Vec3f & p = e.emplace<Position>(Vec3f{4.0f, 5.0f, 6.0f});
+        EXPECT(p.x == 4.0f);
+        e.replace<Position>(7.0f, 8.0f, 9.0f);
+        EXPECT(e.get<Position>().y == 8.0f);
+        e.set<Name>("a");
+        String name("b");
+        e.set<Name>(name);
+        EXPECT(e.get<Name>() == "b");
+        EXPECT(e.ensureComponent<Name>("c") == "b");
+
+        e.destroy();
+        e2.destroy();
+        EXPECT(counter.allocationCount == counter.deallocationCount + 1);
+    },
+    SUITE("Move Only Component Tests")
+    {
+        using Handle = Component<ComponentName("Handle"), std::unique_ptr<int>>;
+        using Mesh = Component<ComponentName("Mesh"), MeshData>;
+        using Position = Component<ComponentName("Position"), Vec3f>;
+
+        static_assert(!CloneTrait<std::unique_ptr<int>>::IsClonable, "");
+        static_assert(CloneTrait<Vec3f>::IsClonable, "");
+
+        Hub hub;
+        Entity a = hub.createEntity();
+        a.set<Handle>(new int(3));
+        a.set<Mesh>(4);
+        a.get<Mesh>().vertices[2] = 5.0f;
+        a.set<Position>(1.0f, 2.0f, 3.0f);
+
+        //components that can't be cloned are skipped instead of leaving a phantom bit
+        Entity b = a.clone();
+        EXPECT(!b.hasComponent<Handle>());
+        EXPECT(!b.maybe<Handle>());
+        EXPECT(b.hasComponent<Position>());
+        EXPECT(b.hasComponent<Mesh>());
+        EXPECT(b.get<Mesh>().vertexCount == 4);
+        EXPECT(b.get<Mesh>().vertices[2] == 5.0f);
+        EXPECT(b.get<Mesh>().vertices.get() != a.get<Mesh>().vertices.get());
+
+        Entity c = a.cloneWith<Handle, Mesh>();
+        EXPECT(!c.hasComponent<Handle>());
+        EXPECT(c.hasComponent<Mesh>());
+        Entity d = a.cloneWithout<Mesh>();
+        EXPECT(!d.hasComponent<Handle>());
+        EXPECT(!d.hasComponent<Mesh>());
+        EXPECT(d.hasComponent<Position>());
+
+        //move only components survive removal, sorting and compaction
+        DynamicArray<Entity> entities;
+        for (int i = 0; i < 300; ++i)
+        {
+            Entity e = hub.createEntity();
+            e.set<Handle>(new int(i));
+            entities.append(e);
+        }
+        for (Size i = 0; i < entities.count(); i += 3)
+            entities[i].destroy();
+        hub.sort<Handle>([](const std::unique_ptr<int> & _a, const std::unique_ptr<int> & _b)
+        {
+            return *_a < *_b;
+        });
+        int last = -1;
+        bool bSorted = true;
+        for (auto e : hub.view<Handle>())
+        {
+            bSorted = bSorted && *e.get<Handle>() > last;
+            last = *e.get<Handle>();
+        }
+        EXPECT(bSorted);
+        hub.compact();
+        Size count = 0;
+        Size sum = 0;
+        for (auto e : hub.view<Handle>())
+        {
+            ++count;
+            sum += *e.get<Handle>();
+        }
+        EXPECT(count == 201);
+        //a's handle plus all i that are not a multiple of 3
+        Size expected = 3;
+        for (Size i = 0; i < 300; ++i)
+            expected += i % 3 ? i : 0;
+        EXPECT(sum == expected);
+    },
+    SUITE("Trivial Component Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+
+        static_assert(std::is_trivially_copyable<Vec3f>::value, "");
+
+        //spans several storage pages, so the bulk copies cross page boundaries
+        Hub hub;
+        DynamicArray<Entity> entities;
+        for (Size i = 0; i < 1000; ++i)
+        {
+            Entity e = hub.createEntity();
+            e.set<Position>((Float32)((i * 7919) % 1000), (Float32)i, 0.0f);
+            e.set<Name>("a");
+            entities.append(e);
+        }
+        for (Size i = 0; i < entities.count(); i += 4)
+            entities[i].destroy();
+
+        hub.sort<Position>([](const Vec3f & _a, const Vec3f & _b) { return _a.x < _b.x; });
+        Float32 last = -1.0f;
+        bool bSorted = true;
+        bool bMatching = true;
+        for (Entity e : hub.view<Position>())
+        {
+            const Vec3f & p = e.get<Position>();
+            bSorted = bSorted && p.x > last;
+            //y is the creation index, so it tells us if the value still belongs to its entity
+            bMatching = bMatching && entities[(Size)p.y] == e;
+            last = p.x;
+        }
+        EXPECT(bSorted);
+        EXPECT(bMatching);
+
+        //compaction copies the pages as a whole and keeps the sorted order
+        hub.compact();
+        EXPECT(hub.entityCount() == 750);
+        last = -1.0f;
+        bSorted = true;
+        Size count = 0;
+        for (Entity e : hub.view<Position>())
+        {
+            const Vec3f & p = e.get<Position>();
+            bSorted = bSorted && p.x > last;
+            last = p.x;
+            ++count;
+            EXPECT(e.get<Name>() == "a");
+        }
+        EXPECT(bSorted);
+        EXPECT(count == 750);
+        for (Entity e : hub)
+            EXPECT(e.hasComponent<Position>() && (Size)e.get<Position>().y % 4 != 0);
+    },
+    SUITE("Migrate Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Velocity = Component<ComponentName("Velocity"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+        using Handle = Component<ComponentName("Handle"), std::unique_ptr<int>>;
+
+        Hub a, b;
+        Entity e = a.createEntity();
+        e.set<Position>(1.0f, 2.0f, 3.0f);
+        e.set<Name>("Eggbert");
+        e.set<Handle>(new int(5));
+        int * raw = e.get<Handle>().get();
+
+        Entity m = a.migrate(e, b);
+        EXPECT(!e.isValid());
+        EXPECT(a.entityCount() == 0);
+        EXPECT(m.isValid());
+        EXPECT(m.hub() == &b);
+        EXPECT(b.entityCount() == 1);
+        EXPECT(m.get<Position>().z == 3.0f);
+        EXPECT(m.get<Name>() == "Eggbert");
+        //moved, not copied
+        EXPECT(m.get<Handle>().get() == raw);
+        EXPECT(!m.hasComponent<Velocity>());
+
+        //typed entities keep their type
+        A typed = createEntity<A>(a);
+        Entity mt = a.migrate(typed, b);
+        EXPECT(entityCast<A>(mt));
+
+        //hierarchy links don't cross hubs
+        Entity parent = a.createEntity();
+        Entity child = a.createEntity();
+        child.setParent(parent);
+        Entity mc = a.migrate(child, b);
+        EXPECT(!mc.hasComponent<Hierarchy>());
+        EXPECT(!parent.firstChild());
+
+        //bulk migration of a view
+        Hub c;
+        for (Size i = 0; i < 300; ++i)
+        {
+            Entity x = a.createEntity();
+            x.set<Position>((Float32)i, 0.0f, 0.0f);
+            if (i % 2)
+                x.set<Velocity>((Float32)i, 1.0f, 0.0f);
+        }
+        Size before = a.entityCount();
+        Size remapped = 0;
+        bool bRemapOK = true;
+        Size moved = a.migrate(a.view<Velocity>(), c, [&](const Entity & _old, const Entity & _new)
+        {
+            ++remapped;
+            bRemapOK = bRemapOK && !_old.isValid() && _new.hub() == &c && _new.get<Velocity>().y == 1.0f;
+        });
+        EXPECT(moved == 150);
+        EXPECT(remapped == 150);
+        EXPECT(bRemapOK);
+        EXPECT(a.entityCount() == before - 150);
+        EXPECT(c.entityCount() == 150);
+        bool bMatching = true;
+        Size count = 0;
+        for (Entity x : c.view<Position, Velocity>())
+        {
+            bMatching = bMatching && x.get<Position>().x == x.get<Velocity>().x;
+            ++count;
+        }
+        EXPECT(count == 150);
+        EXPECT(bMatching);
+        count = 0;
+        for (Entity x : a.view<Velocity>())
+            ++count;
+        EXPECT(count == 0);
+    },
+    SUITE("Splice Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+
+        Hub live;
+        Entity existing = live.createEntity();
+        existing.set<Position>(-1.0f, 0.0f, 0.0f);
+        existing.set<Name>("live");
+
+        //fill the staging hub on a worker thread
+        Hub staging;
+        std::thread loader([&]()
+        {
+            for (Size i = 0; i < 500; ++i)
+            {
+                Entity e = staging.createEntity();
+                e.set<Position>((Float32)i, 0.0f, 0.0f);
+                if (i % 5 == 0)
+                    e.set<Name>("staged");
+            }
+            staging.createEntity().destroy();
+            createEntity<A>(staging);
+            Entity parent = staging.createEntity();
+            Entity child = staging.createEntity();
+            child.setParent(parent);
+        });
+        loader.join();
+
+        Size remapped = 0;
+        bool bRemapOK = true;
+        Size moved = live.splice(staging, [&](const Entity &, const Entity & _new)
+        {
+            ++remapped;
+            bRemapOK = bRemapOK && _new.hub() == &live && _new.isValid();
+        });
+        EXPECT(moved == 503);
+        EXPECT(remapped == 503);
+        EXPECT(bRemapOK);
+        EXPECT(staging.entityCount() == 0);
+        EXPECT(live.entityCount() == 504);
+        EXPECT(existing.isValid());
+        EXPECT(existing.get<Position>().x == -1.0f);
+        EXPECT(existing.get<Name>() == "live");
+
+        Size count = 0;
+        Float32 sum = 0.0f;
+        for (Entity e : live.view<Position>())
+        {
+            ++count;
+            sum += e.get<Position>().x;
+        }
+        EXPECT(count == 501);
+        EXPECT(sum == -1.0f + 499.0f * 500.0f / 2.0f);
+        count = 0;
+        for (Entity e : live.view<Name>())
+            ++count;
+        EXPECT(count == 101);
+        count = 0;
+        for (A a : live.viewOfType<A>())
+            ++count;
+        EXPECT(count == 1);
+
+        //hierarchy links follow the offset
+        Size children = 0;
+        for (Entity e : live.view<Hierarchy>())
+        {
+            if (e.parent())
+            {
+                ++children;
+                EXPECT(e.parent().firstChild() == e);
+            }
+        }
+        EXPECT(children == 1);
+
+        //the free id of the staging hub is reused by the live hub
+        Entity reused = live.createEntity();
+        EXPECT(reused.id() > 0);
+        EXPECT(!reused.hasComponent<Position>());
+    },
+    SUITE("Snapshot Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+        using Mesh = Component<ComponentName("Mesh"), MeshData>;
+
+        CountingAllocator counter;
+        {
+            Hub hub(counter);
+            DynamicArray<Entity> entities;
+            for (Size i = 0; i < 1000; ++i)
+            {
+                Entity e = hub.createEntity();
+                e.set<Position>((Float32)i, 0.0f, 0.0f);
+                if (i % 10 == 0)
+                    e.set<Name>("a");
+                entities.append(e);
+            }
+            entities[1].set<Mesh>(MeshData(16));
+            Entity parent = entities[2];
+            entities[3].setParent(parent);
+
+            Hub::Snapshot first = hub.snapshot();
+            EXPECT(first.entityCount() == 1000);
+
+            //nothing changed, so no page is copied
+            Size allocations = counter.allocationCount;
+            Hub::Snapshot second = hub.snapshot();
+            Size unchangedCost = counter.allocationCount - allocations;
+
+            //writing one component copies a single page of its storage
+            entities[500].get<Position>().y = 1.0f;
+            allocations = counter.allocationCount;
+            Hub::Snapshot third = hub.snapshot();
+            EXPECT(counter.allocationCount - allocations == unchangedCost + 1);
+
+            //change the world in all kinds of ways
+            entities[0].get<Position>().x = -1.0f;
+            entities[10].set<Name>("b");
+            entities[20].removeComponent<Name>();
+            Entity(entities[30]).destroy();
+            entities[3].setParent(Entity());
+            entities[1].get<Mesh>().vertices[0] = 99.0f;
+            Entity created = hub.createEntity();
+            created.set<Position>(5.0f, 5.0f, 5.0f);
+            created.set<Name>("c");
+            hub.sort<Position>([](const Vec3f & _a, const Vec3f & _b) { return _a.x < _b.x; });
+            EXPECT(hub.entityCount() == 1000);
+
+            hub.restore(first);
+            EXPECT(hub.entityCount() == 1000);
+            EXPECT(!created.isValid());
+            bool bValid = true;
+            bool bValues = true;
+            Size names = 0;
+            for (Size i = 0; i < entities.count(); ++i)
+            {
+                Entity e = entities[i];
+                bValid = bValid && e.isValid();
+                bValues = bValues && e.get<Position>().x == (Float32)i && e.get<Position>().y == 0.0f;
+                if (e.hasComponent<Name>())
+                {
+                    ++names;
+                    bValues = bValues && e.get<Name>() == "a" && i % 10 == 0;
+                }
+            }
+            EXPECT(bValid);
+            EXPECT(bValues);
+            EXPECT(names == 100);
+            EXPECT(entities[3].parent() == parent);
+            EXPECT(entities[1].get<Mesh>().vertices[0] == 0.0f);
+            Size count = 0;
+            for (Entity e : hub.view<Position, Name>())
+                ++count;
+            EXPECT(count == 100);
+
+            //replaying the same steps after the rollback yields the same handles
+            Entity(entities[30]).destroy();
+            Entity recreated = hub.createEntity();
+            EXPECT(recreated == created);
+            EXPECT(!recreated.hasComponent<Position>());
+
+            hub.restore(third);
+            EXPECT(!created.isValid());
+            EXPECT(entities[500].get<Position>().y == 1.0f);
+            EXPECT(entities[499].get<Position>().y == 0.0f);
+
+            //writes through references taken before a snapshot are caught, too
+            Vec3f & position = entities[700].get<Position>();
+            String & name = entities[700].get<Name>();
+            Hub::Snapshot before = hub.snapshot();
+            position.y = 7.0f;
+            name = "d";
+            Hub::Snapshot after = hub.snapshot();
+            EXPECT(Hub::diff(before, after).count() > Hub::diff(after, after).count());
+            hub.restore(before);
+            EXPECT(entities[700].get<Position>().y == 0.0f);
+            EXPECT(entities[700].get<Name>() == "a");
+            hub.restore(after);
+            EXPECT(entities[700].get<Position>().y == 7.0f);
+            EXPECT(entities[700].get<Name>() == "d");
+            hub.restore(third);
+
+            //snapshots can be restored after clear() and into other hubs
+            hub.clear();
+            EXPECT(!entities[0].isValid());
+            hub.restore(second);
+            EXPECT(entities[0].isValid());
+            EXPECT(entities[999].get<Position>().x == 999.0f);
+
+            Hub other;
+            other.restore(second);
+            EXPECT(other.entityCount() == 1000);
+            names = 0;
+            for (Entity e : other.view<Name>())
+                names += e.get<Name>() == "a";
+            EXPECT(names == 100);
+            for (Entity e : other.view<Mesh>())
+                EXPECT(e.get<Mesh>().vertexCount == 16);
+
+            //an empty snapshot destroys everything
+            hub.restore(Hub::Snapshot());
+            EXPECT(hub.entityCount() == 0);
+            EXPECT(!entities[0].isValid());
+        }
+        EXPECT(counter.allocationCount == counter.deallocationCount);
+
+        {
+            //components that can't be cloned are not captured, they stay with the entities
+            //that survive the restore and are removed from the others
+            using Handle = Component<ComponentName("Handle"), std::unique_ptr<int>>;
+            Hub hub;
+            Entity kept = hub.createEntity();
+            kept.set<Handle>(std::unique_ptr<int>(new int(1)));
+            Entity gone = hub.createEntity();
+            gone.set<Handle>(std::unique_ptr<int>(new int(2)));
+            auto shared = createEntity<SharedTypedEntity>(hub);
+            Hub::Snapshot snapshot = hub.snapshot();
+
+            *kept.get<Handle>() = 3;
+            Entity(gone).destroy();
+            Entity later = hub.createEntity();
+            later.set<Handle>(std::unique_ptr<int>(new int(4)));
+            Hub::Snapshot changed = hub.snapshot();
+            EXPECT(Hub::diff(snapshot, changed).count() > 0);
+            hub.restore(snapshot);
+            EXPECT(!later.isValid());
+            EXPECT(gone.isValid() && !gone.hasComponent<Handle>());
+            EXPECT(kept.hasComponent<Handle>() && *kept.get<Handle>() == 3);
+            EXPECT(shared.isValid() && shared.referenceCount() == 1);
+            Size handles = 0;
+            for (Entity e : hub.view<Handle>())
+                handles += e == kept;
+            EXPECT(handles == 1);
+
+            Hub other;
+            other.restore(snapshot);
+            EXPECT(other.entityCount() == 3);
+            EXPECT(other.view<Handle>().size() == 0);
+        }
+    },
+    SUITE("Delta Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Velocity = Component<ComponentName("Velocity"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+
+        //the client mirrors the packed storages of the server, so the views line up
+        auto isMirrored = [](Hub & _server, Hub & _client)
+        {
+            if (_server.entityCount() != _client.entityCount())
+                return false;
+            auto sv = _server.view<Position>();
+            auto cv = _client.view<Position>();
+            auto ci = cv.begin();
+            for (Entity e : sv)
+            {
+                if (ci == cv.end())
+                    return false;
+                Entity c = *ci;
+                if (c.id() != e.id() || !c.isValid() || c.get<Position>().x != e.get<Position>().x ||
+                        c.get<Position>().y != e.get<Position>().y ||
+                        c.hasComponent<Velocity>() != e.hasComponent<Velocity>())
+                    return false;
+                ++ci;
+            }
+            return ci == cv.end();
+        };
+
+        Hub server;
+        DynamicArray<Entity> entities;
+        for (Size i = 0; i < 1000; ++i)
+        {
+            Entity e = server.createEntity();
+            e.set<Position>((Float32)i, 0.0f, 0.0f);
+            if (i % 2 == 0)
+                e.set<Velocity>(1.0f, 0.0f, 0.0f);
+            e.set<Name>("server");
+            entities.append(e);
+        }
+        entities[5].setParent(entities[4]);
+
+        Hub client;
+        Hub::Snapshot baseline = server.snapshot();
+        auto full = Hub::diff(Hub::Snapshot(), baseline);
+        EXPECT(client.applyDelta(full.ptr(), full.count()));
+        EXPECT(isMirrored(server, client));
+
+        //a delta that turns out to be malformed leaves the hub untouched
+        Hub untouched;
+        EXPECT(!untouched.applyDelta(full.ptr(), full.count() - 1));
+        EXPECT(untouched.stats().components.count() == 0);
+        EXPECT(untouched.entityCount() == 0);
+
+        {
+            //so does one with an entity id out of range
+            Hub single;
+            single.createEntity().set<Position>(1234.5f, 0.0f, 0.0f);
+            auto raw = Hub::diff(Hub::Snapshot(), single.snapshot(), false);
+            Vec3f value{1234.5f, 0.0f, 0.0f};
+            Size offset = 0;
+            for (Size i = 0; i + sizeof(Vec3f) <= raw.count(); ++i)
+            {
+                if (!std::memcmp(&raw[i], &value, sizeof(Vec3f)))
+                    offset = i;
+            }
+            EXPECT(offset >= sizeof(EntityID));
+            EntityID id;
+            std::memcpy(&id, &raw[offset - sizeof(EntityID)], sizeof(EntityID));
+            EXPECT(id == 0);
+            id = 1000;
+            std::memcpy(&raw[offset - sizeof(EntityID)], &id, sizeof(EntityID));
+            EXPECT(!untouched.applyDelta(raw.ptr(), raw.count()));
+            EXPECT(untouched.stats().components.count() == 0);
+            EXPECT(untouched.entityCount() == 0);
+            id = 0;
+            std::memcpy(&raw[offset - sizeof(EntityID)], &id, sizeof(EntityID));
+            EXPECT(untouched.applyDelta(raw.ptr(), raw.count()));
+            EXPECT(untouched.entityCount() == 1);
+        }
+        //components that are not trivially copyable are not replicated
+        EXPECT(client.view<Name>().begin() == client.view<Name>().end());
+
+        //a delta without changes is tiny
+        Hub::Snapshot current = server.snapshot();
+        auto empty = Hub::diff(baseline, current);
+        EXPECT(empty.count() < 16);
+        EXPECT(client.applyDelta(empty.ptr(), empty.count()));
+
+        //changing a single component only sends its page, XOR+RLE shrinks it further
+        entities[500].get<Position>().y = 2.0f;
+        baseline = std::move(current);
+        current = server.snapshot();
+        auto raw = Hub::diff(baseline, current, false);
+        auto delta = Hub::diff(baseline, current);
+        EXPECT(delta.count() < raw.count());
+        EXPECT(raw.count() < full.count() / 4);
+        EXPECT(delta.count() < 100);
+        EXPECT(client.applyDelta(delta.ptr(), delta.count()));
+        EXPECT(isMirrored(server, client));
+
+        //applying it again does not match the state of the client anymore
+        EXPECT(!client.applyDelta(delta.ptr(), delta.count()));
+        //neither does a truncated delta
+        EXPECT(!client.applyDelta(delta.ptr(), delta.count() - 1));
+        EXPECT(isMirrored(server, client));
+
+        //create, destroy, remove and reparent
+        Entity clientEntity;
+        for (Entity e : client.view<Position>())
+        {
+            if (e.id() == 10)
+                clientEntity = e;
+        }
+        clientEntity.set<Name>("client only");
+        Entity(entities[10]).destroy();
+        entities[20].removeComponent<Velocity>();
+        entities[30].set<Velocity>(3.0f, 0.0f, 0.0f);
+        entities[5].setParent(entities[6]);
+        Entity created = server.createEntity();
+        created.set<Position>(-1.0f, 0.0f, 0.0f);
+        Entity fresh = server.createEntity();
+        fresh.set<Position>(-2.0f, 0.0f, 0.0f);
+        baseline = std::move(current);
+        current = server.snapshot();
+        delta = Hub::diff(baseline, current);
+        EXPECT(client.applyDelta(delta.ptr(), delta.count()));
+        EXPECT(isMirrored(server, client));
+        EXPECT(!clientEntity.isValid());
+
+        Size withName = 0;
+        for (Entity e : client.view<Name>())
+            ++withName;
+        EXPECT(withName == 0);
+        for (Entity e : client.view<Hierarchy>())
+        {
+            if (e.id() == 5)
+                EXPECT(e.parent().id() == 6);
+        }
+
+        //the handles of the server are valid on the client, too
+        Size versionMatches = 0;
+        for (Entity e : client.view<Position>())
+        {
+            if (e.id() == created.id())
+                versionMatches += e.version() == created.version() && e.get<Position>().x == -1.0f;
+        }
+        EXPECT(versionMatches == 1);
+    },
+    SUITE("Spatial Index Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Bounds = Component<ComponentName("Bounds"), Box>;
+
+        struct CountingObserver : public ComponentObserver
+        {
+            void componentSet(EntityID, const void *)
+            {
+                ++sets;
+            }
+
+            void componentRemoved(EntityID)
+            {
+                ++removals;
+            }
+
+            void componentsReset()
+            {
+                ++resets;
+            }
+
+            Size sets = 0;
+            Size removals = 0;
+            Size resets = 0;
+        };
+
+        Hub hub;
+        DynamicArray<Entity> entities;
+        for (Size i = 0; i < 20; ++i)
+        {
+            for (Size j = 0; j < 20; ++j)
+            {
+                Entity e = hub.createEntity();
+                e.set<Position>(i * 5.0f, j * 5.0f, 0.0f);
+                entities.append(e);
+            }
+        }
+
+        //the existing components are indexed right away
+        auto & observer = static_cast<CountingObserver &>(hub.addObserver<Position>(
+                              UniquePtr<ComponentObserver>(defaultAllocator().create<CountingObserver>(), defaultAllocator())));
+        EXPECT(observer.sets == 400);
+        SpatialIndex & index = hub.enableSpatialIndex<Position>(8.0f);
+        EXPECT(index.count() == 400);
+
+        auto bruteForce = [&](const AABB & _b)
+        {
+            Size ret = 0;
+            for (Entity e : hub.view<Position>())
+            {
+                const Vec3f & p = e.get<Position>();
+                ret += p.x >= _b.min[0] && p.x <= _b.max[0] && p.y >= _b.min[1] && p.y <= _b.max[1] && p.z >= _b.min[2] && p.z <= _b.max[2];
+            }
+            return ret;
+        };
+        auto matches = [&](const AABB & _b)
+        {
+            DynamicArray<Entity> result = hub.query<Position>(_b);
+            bool bInside = true;
+            for (Entity e : result)
+            {
+                const Vec3f & p = e.get<Position>();
+                bInside = bInside && e.isValid() && p.x >= _b.min[0] && p.x <= _b.max[0] && p.y >= _b.min[1] && p.y <= _b.max[1];
+            }
+            return bInside && result.count() == bruteForce(_b);
+        };
+
+        EXPECT(hub.query<Position>({{0.0f, 0.0f, -1.0f}, {12.0f, 12.0f, 1.0f}}).count() == 9);
+        EXPECT(matches({{-3.0f, 7.0f, -1.0f}, {33.0f, 41.0f, 1.0f}}));
+        EXPECT(matches({{-1000.0f, -1000.0f, -1000.0f}, {1000.0f, 1000.0f, 1000.0f}}));
+        EXPECT(matches({{50.0f, 50.0f, 0.0f}, {50.0f, 50.0f, 0.0f}}));
+        EXPECT(matches({{200.0f, 0.0f, 0.0f}, {300.0f, 100.0f, 0.0f}}));
+
+        //set, remove and destroy keep the index up to date
+        entities[0].set<Position>(500.0f, 500.0f, 0.0f);
+        entities[1].set<Position>(1.0f, 1.0f, 0.0f);
+        entities[2].removeComponent<Position>();
+        Entity(entities[3]).destroy();
+        EXPECT(index.count() == 398);
+        EXPECT(observer.removals == 2);
+        EXPECT(hub.query<Position>({{499.0f, 499.0f, -1.0f}, {501.0f, 501.0f, 1.0f}}).count() == 1);
+        EXPECT(matches({{0.0f, 0.0f, -1.0f}, {12.0f, 12.0f, 1.0f}}));
+
+        //cells that run empty are recycled, so moving entities don't grow the index. The cell
+        //of entities[1] stays behind, it no longer shares it with the moving ones.
+        Size cells = index.cellCount();
+        for (Size step = 1; step <= 50; ++step)
+        {
+            for (Size i = 4; i < 400; ++i)
+                entities[i].set<Position>((i / 20) * 5.0f + step * 1000.0f, (i % 20) * 5.0f, 0.0f);
+            EXPECT(index.cellCount() == cells + 1);
+        }
+        EXPECT(matches({{49990.0f, -10.0f, -1.0f}, {50200.0f, 200.0f, 1.0f}}));
+        for (Size i = 4; i < 400; ++i)
+            entities[i].set<Position>((i / 20) * 5.0f, (i % 20) * 5.0f, 0.0f);
+        EXPECT(index.cellCount() == cells);
+        EXPECT(matches({{-3.0f, 7.0f, -1.0f}, {33.0f, 41.0f, 1.0f}}));
+        EXPECT(matches({{-1000.0f, -1000.0f, -1000.0f}, {1000.0f, 1000.0f, 1000.0f}}));
+
+        //compact moves entities to new ids
+        hub.compact();
+        EXPECT(index.count() == 398);
+        EXPECT(observer.resets == 1);
+        EXPECT(matches({{-3.0f, -3.0f, -1.0f}, {33.0f, 41.0f, 1.0f}}));
+        EXPECT(matches({{-1000.0f, -1000.0f, -1000.0f}, {1000.0f, 1000.0f, 1000.0f}}));
+
+        //snapshots restore the index, too
+        Hub::Snapshot snapshot = hub.snapshot();
+        for (Entity e : hub.view<Position>())
+            e.set<Position>(-100.0f, -100.0f, 0.0f);
+        EXPECT(hub.query<Position>({{-3.0f, -3.0f, -1.0f}, {33.0f, 41.0f, 1.0f}}).count() == 0);
+        hub.restore(snapshot);
+        EXPECT(matches({{-3.0f, -3.0f, -1.0f}, {33.0f, 41.0f, 1.0f}}));
+
+        hub.clear();
+        EXPECT(index.count() == 0);
+        Entity late = hub.createEntity();
+        late.set<Position>(1.0f, 2.0f, 3.0f);
+        EXPECT(hub.query<Position>({{0.0f, 0.0f, 0.0f}, {4.0f, 4.0f, 4.0f}}).count() == 1);
+
+        //bounds that span several cells are reported once, huge ones end up in the oversized list
+        hub.enableSpatialIndex<Bounds>(1.0f);
+        Entity wide = hub.createEntity();
+        wide.set<Bounds>(Box{{0.0f, 0.0f, 0.0f}, {2.5f, 2.5f, 0.5f}});
+        Entity huge = hub.createEntity();
+        huge.set<Bounds>(Box{{-100.0f, -100.0f, -100.0f}, {100.0f, 100.0f, 100.0f}});
+        Entity small = hub.createEntity();
+        small.set<Bounds>(Box{{10.0f, 10.0f, 0.0f}, {10.5f, 10.5f, 0.5f}});
+        EXPECT(hub.query<Bounds>({{0.0f, 0.0f, 0.0f}, {3.0f, 3.0f, 1.0f}}).count() == 2);
+        EXPECT(hub.query<Bounds>({{1.5f, 1.5f, 0.0f}, {1.6f, 1.6f, 0.1f}}).count() == 2);
+        EXPECT(hub.query<Bounds>({{9.0f, 9.0f, 0.0f}, {11.0f, 11.0f, 1.0f}}).count() == 2);
+        EXPECT(hub.query<Bounds>({{200.0f, 200.0f, 200.0f}, {300.0f, 300.0f, 300.0f}}).count() == 0);
+        huge.removeComponent<Bounds>();
+        EXPECT(hub.query<Bounds>({{-50.0f, -50.0f, -50.0f}, {50.0f, 50.0f, 50.0f}}).count() == 2);
+        wide.set<Bounds>(Box{{20.0f, 20.0f, 0.0f}, {20.5f, 20.5f, 0.5f}});
+        EXPECT(hub.query<Bounds>({{0.0f, 0.0f, 0.0f}, {3.0f, 3.0f, 1.0f}}).count() == 0);
+        EXPECT(hub.spatialIndex<Bounds>().count() == 2);
+    },
+    SUITE("Component Index Tests")
+    {
+        using Name = Component<ComponentName("Name"), String>;
+
+        struct AssetData
+        {
+            UInt64 guid;
+            Int32 revision;
+        };
+        using Asset = Component<ComponentName("Asset"), AssetData>;
+
+        Hub hub;
+        Entity eggbert = hub.createEntity();
+        eggbert.set<Name>("Eggbert");
+
+        //existing components are indexed right away
+        hub.enableIndex<Name>();
+        EXPECT(hub.find<Name>("Eggbert") == eggbert);
+        EXPECT(!hub.find<Name>("Bob").isValid());
+
+        DynamicArray<Entity> entities;
+        for (Size i = 0; i < 500; ++i)
+        {
+            Entity e = hub.createEntity();
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "Entity%lu", (unsigned long)i);
+            e.set<Name>(buf);
+            e.set<Asset>(AssetData{1000 + i % 10, (Int32)i});
+            entities.append(e);
+        }
+        EXPECT(hub.index<Name>().count() == 501);
+        EXPECT(hub.find<Name>("Entity123") == entities[123]);
+        EXPECT(hub.find<Name>("Entity499") == entities[499]);
+
+        //non unique index on a field
+        hub.enableIndex<Asset>([](const AssetData & _asset) { return _asset.guid; }, false);
+        DynamicArray<Entity> found;
+        EXPECT((hub.findAll<Asset, UInt64>(1003, found)) == 50);
+        bool bAllMatch = true;
+        for (Entity e : found)
+            bAllMatch = bAllMatch && e.get<Asset>().guid == 1003;
+        EXPECT(bAllMatch);
+        EXPECT((hub.find<Asset, UInt64>(1007).get<Asset>().guid == 1007));
+        EXPECT(!(hub.find<Asset, UInt64>(2000).isValid()));
+
+        //set, remove and destroy keep the indices up to date
+        entities[123].set<Name>("Renamed");
+        EXPECT(!hub.find<Name>("Entity123").isValid());
+        EXPECT(hub.find<Name>("Renamed") == entities[123]);
+        entities[124].removeComponent<Name>();
+        EXPECT(!hub.find<Name>("Entity124").isValid());
+        entities[3].set<Asset>(AssetData{2000, 0});
+        Entity(entities[13]).destroy();
+        found.clear();
+        EXPECT((hub.findAll<Asset, UInt64>(1003, found)) == 48);
+        EXPECT((hub.find<Asset, UInt64>(2000) == entities[3]));
+        EXPECT(!hub.find<Name>("Entity13").isValid());
+        EXPECT(hub.index<Name>().count() == 499);
+
+        //compact moves entities to new ids
+        hub.compact();
+        EXPECT(hub.find<Name>("Entity200").get<Name>() == "Entity200");
+        EXPECT(hub.find<Name>("Renamed").get<Asset>().revision == 123);
+        found.clear();
+        EXPECT((hub.findAll<Asset, UInt64>(1003, found)) == 48);
+
+        hub.clear();
+        EXPECT(hub.index<Name>().count() == 0);
+        EXPECT(!hub.find<Name>("Eggbert").isValid());
+        Entity e = hub.createEntity();
+        e.set<Name>("Eggbert");
+        EXPECT(hub.find<Name>("Eggbert") == e);
+    },
+    SUITE("Singleton Tests")
+    {
+        struct TimeData
+        {
+            Float64 now;
+            Float64 delta;
+        };
+        using Time = Component<ComponentName("Time"), TimeData>;
+        using Config = Component<ComponentName("Config"), String>;
+        using Position = Component<ComponentName("Position"), Vec3f>;
+
+        Hub hub;
+        EXPECT(!hub.hasSingleton<Time>());
+        TimeData & time = hub.setSingleton<Time>(TimeData{0.0, 1.0 / 60.0});
+        EXPECT(hub.hasSingleton<Time>());
+        EXPECT(&hub.singleton<Time>() == &time);
+        time.now += time.delta;
+        EXPECT(hub.singleton<Time>().now == 1.0 / 60.0);
+
+        //setting it again keeps the address
+        hub.setSingleton<Time>(TimeData{5.0, 0.5});
+        EXPECT(&hub.singleton<Time>() == &time);
+        EXPECT(time.now == 5.0);
+
+        //aggregates can be set from their fields like components
+        Hub fields;
+        fields.setSingleton<Time>(1.0, 0.25);
+        EXPECT(fields.singleton<Time>().now == 1.0 && fields.singleton<Time>().delta == 0.25);
+        TimeData & fieldTime = fields.singleton<Time>();
+        fields.setSingleton<Time>(2.0, 0.5);
+        EXPECT(&fields.singleton<Time>() == &fieldTime);
+        EXPECT(fieldTime.now == 2.0 && fieldTime.delta == 0.5);
+
+        hub.setSingleton<Config>("fullscreen");
+        const Hub & constHub = hub;
+        EXPECT(constHub.singleton<Config>() == "fullscreen");
+
+        //singletons do not belong to any entity and survive clear
+        for (Size i = 0; i < 100; ++i)
+            hub.createEntity().set<Position>(1.0f, 2.0f, 3.0f);
+        Entity e = hub.createEntity();
+        EXPECT(!e.hasComponent<Time>());
+        hub.clear();
+        EXPECT(hub.singleton<Time>().now == 5.0);
+        EXPECT(hub.singleton<Config>() == "fullscreen");
+
+        hub.removeSingleton<Config>();
+        EXPECT(!hub.hasSingleton<Config>());
+        EXPECT(hub.hasSingleton<Time>());
+        hub.setSingleton<Config>("windowed");
+        EXPECT(hub.singleton<Config>() == "windowed");
+    },
+    SUITE("Tag Tests")
+    {
+        struct DeadTag
+        {
+        };
+        struct SelectedTag
+        {
+        };
+        using Dead = Component<ComponentName("Dead"), DeadTag>;
+        using Selected = Component<ComponentName("Selected"), SelectedTag>;
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        static_assert(Dead::IsTag && !Position::IsTag, "empty components are tags");
+
+        Hub hub;
+        DynamicArray<Entity> entities;
+        for (Size i = 0; i < 300; ++i)
+        {
+            Entity e = hub.createEntity();
+            if (i % 2 == 0)
+                e.set<Position>((Float32)i, 0.0f, 0.0f);
+            if (i % 3 == 0)
+                e.set<Dead>();
+            if (i % 5 == 0)
+                e.set<Selected>();
+            entities.append(e);
+        }
+
+        //tags don't get a storage
+        bool bTagStorage = false;
+        for (const ComponentStats & cs : hub.stats().components)
+            bTagStorage = bTagStorage || cs.hash == Dead::hash() || cs.hash == Selected::hash();
+        EXPECT(!bTagStorage);
+
+        EXPECT(entities[3].hasComponent<Dead>());
+        EXPECT(!entities[4].hasComponent<Dead>());
+        EXPECT(entities[3].maybe<Dead>());
+        EXPECT(!entities[4].maybe<Dead>());
+        EXPECT(countEntities(hub.view<Dead>()) == 100);
+        EXPECT(countEntities(hub.view<Dead, Selected>()) == 20);
+        EXPECT(countEntities(hub.view<Dead, Position>()) == 50);
+        EXPECT(countEntities(hub.view<Position, Dead, Selected>()) == 10);
+        bool bAllMatch = true;
+        for (Entity e : hub.view<Selected, Position>())
+            bAllMatch = bAllMatch && e.hasComponent<Selected>() && e.hasComponent<Position>();
+        EXPECT(bAllMatch);
+
+        //removing tags and destroying entities while iterating a tag view
+        for (Entity e : hub.view<Dead>())
+        {
+            if (e.hasComponent<Selected>())
+                e.destroy();
+            else
+                e.removeComponent<Dead>();
+        }
+        EXPECT(countEntities(hub.view<Dead>()) == 0);
+        EXPECT(countEntities(hub.view<Selected>()) == 40);
+        EXPECT(hub.entityCount() == 280);
+
+        //clones keep their tags unless they are excluded
+        Entity tagged = hub.createEntity();
+        tagged.set<Dead>();
+        tagged.set<Selected>();
+        tagged.set<Position>(1.0f, 2.0f, 3.0f);
+        Entity a = tagged.clone();
+        EXPECT(a.hasComponent<Dead>() && a.hasComponent<Selected>() && a.hasComponent<Position>());
+        Entity b = tagged.cloneWithout<Dead>();
+        EXPECT(!b.hasComponent<Dead>() && b.hasComponent<Selected>() && b.hasComponent<Position>());
+        Entity c = tagged.cloneWith<Dead>();
+        EXPECT(c.hasComponent<Dead>() && !c.hasComponent<Selected>() && !c.hasComponent<Position>());
+
+        //compact and snapshots carry the bits along
+        hub.compact();
+        EXPECT(countEntities(hub.view<Dead>()) == 3);
+        EXPECT(countEntities(hub.view<Selected>()) == 43);
+        Hub::Snapshot snapshot = hub.snapshot();
+        for (Entity e : hub.view<Selected>())
+            e.removeComponent<Selected>();
+        EXPECT(countEntities(hub.view<Selected>()) == 0);
+        hub.restore(snapshot);
+        EXPECT(countEntities(hub.view<Selected>()) == 43);
+
+        //tags are replicated by deltas
+        Hub client;
+        Hub::Snapshot baseline = hub.snapshot();
+        auto full = Hub::diff(Hub::Snapshot(), baseline);
+        EXPECT(client.applyDelta(full.ptr(), full.count()));
+        EXPECT(countEntities(client.view<Selected>()) == 43);
+        EXPECT(countEntities(client.view<Dead, Position>()) == 2);
+        Entity first = *hub.view<Selected>().begin();
+        first.removeComponent<Selected>();
+        hub.createEntity().set<Dead>();
+        Hub::Snapshot current = hub.snapshot();
+        auto delta = Hub::diff(baseline, current);
+        EXPECT(client.applyDelta(delta.ptr(), delta.count()));
+        EXPECT(countEntities(client.view<Selected>()) == 42);
+        EXPECT(countEntities(client.view<Dead>()) == 4);
+        bool bRemoved = true;
+        for (Entity e : client.view<Selected>())
+            bRemoved = bRemoved && e.id() != first.id();
+        EXPECT(bRemoved);
+    },
+    SUITE("Chunk Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Velocity = Component<ComponentName("Velocity"), Vec3f>;
+
+        Hub hub;
+        EXPECT(hub.view<Position>().chunks(32).count() == 0);
+
+        for (Size i = 0; i < 1000; ++i)
+        {
+            Entity e = hub.createEntity();
+            e.set<Position>((Float32)i, 0.0f, 0.0f);
+            if (i % 2 == 0)
+                e.set<Velocity>(1.0f, 2.0f, 0.0f);
+        }
+
+        //chunks never cross a page of 128 components
+        auto chunks = hub.view<Position, Velocity>().chunks(32);
+        EXPECT(chunks.count() == 7 * 4 + 4);
+        EXPECT(std::distance(chunks.begin(), chunks.end()) == (std::ptrdiff_t)chunks.count());
+        EXPECT(hub.view<Position>().chunks(1000).count() == 8);
+        EXPECT(hub.view<Position>().chunks(128).count() == 8);
+        EXPECT(hub.view<Position>().chunks(1).count() == 1000);
+        Size total = 0;
+        bool bContiguous = true;
+        for (auto it = chunks.begin(); it != chunks.end(); ++it)
+        {
+            auto chunk = *it;
+            total += chunk.count();
+            for (Size i = 0; i < chunk.count(); ++i)
+                bContiguous = bContiguous && chunk.entity(i).get<Position>().x == chunk.values()[i].x;
+        }
+        EXPECT(total == 1000);
+        EXPECT(bContiguous);
+        EXPECT((*(chunks.begin() + 5)).count() == 32);
+        EXPECT(chunks.begin()[31].count() == 1000 - 7 * 128 - 3 * 32);
+        EXPECT(chunks.end() - chunks.begin() == 32 && chunks.begin() < chunks.end());
+
+        //the chunks can be processed from several threads, even with a snapshot around
+        Hub::Snapshot snapshot = hub.snapshot();
+        auto parallel = hub.view<Position, Velocity>().chunks(32);
+        std::vector<std::thread> threads;
+        for (Size t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&parallel, t]()
+            {
+                for (Size c = t; c < parallel.count(); c += 4)
+                {
+                    auto chunk = parallel[c];
+                    Vec3f * positions = chunk.values();
+                    for (Size i = 0; i < chunk.count(); ++i)
+                    {
+                        if (chunk.matches(i))
+                            positions[i].y += chunk.get<Velocity>(i).y;
+                    }
+                }
+            });
+        }
+        for (auto & t : threads)
+            t.join();
+
+        bool bMoved = true;
+        for (Entity e : hub.view<Position>())
+            bMoved = bMoved && e.get<Position>().y == (e.hasComponent<Velocity>() ? 2.0f : 0.0f);
+        EXPECT(bMoved);
+        hub.restore(snapshot);
+        bool bRestored = true;
+        for (Entity e : hub.view<Position>())
+            bRestored = bRestored && e.get<Position>().y == 0.0f;
+        EXPECT(bRestored);
+    },
+    SUITE("Random Access Iterator Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Velocity = Component<ComponentName("Velocity"), Vec3f>;
+        struct HighlightedTag
+        {
+        };
+        using Highlighted = Component<ComponentName("Highlighted"), HighlightedTag>;
+
+        Hub hub;
+        DynamicArray<Entity> entities;
+        for (Size i = 0; i < 200; ++i)
+        {
+            Entity e = hub.createEntity();
+            e.set<Position>((Float32)i, 0.0f, 0.0f);
+            if (i % 3 == 0)
+                e.set<Velocity>(1.0f, 0.0f, 0.0f);
+            if (i % 4 == 0)
+                e.set<Highlighted>();
+            entities.append(e);
+        }
+        //free ids at the start, in the middle, in a row and at the end
+        Size destroyed[] = {0, 1, 17, 18, 19, 100, 150, 199};
+        for (Size id : destroyed)
+            Entity(entities[id]).destroy();
+
+        DynamicArray<EntityID> alive;
+        for (Size i = 0; i < 200; ++i)
+        {
+            if (std::find(std::begin(destroyed), std::end(destroyed), i) == std::end(destroyed))
+                alive.append(i);
+        }
+
+        auto begin = hub.begin();
+        auto end = hub.end();
+        EXPECT(std::distance(begin, end) == (std::ptrdiff_t)hub.entityCount());
+        EXPECT(end - begin == (std::ptrdiff_t)alive.count());
+        EXPECT((*begin).id() == 2);
+        bool bIndexed = true;
+        for (Size i = 0; i < alive.count(); ++i)
+            bIndexed = bIndexed && begin[i].id() == alive[i] && (*(begin + i)).id() == alive[i] && (begin + i) - begin == (std::ptrdiff_t)i;
+        EXPECT(bIndexed);
+        EXPECT(begin + alive.count() == end);
+        EXPECT((*(end - 1)).id() == 198);
+        EXPECT((*(begin + 10)).id() == alive[10]);
+
+        //+= and ++ advance by the same amount
+        auto stepped = begin;
+        for (Size i = 0; i < 20; ++i)
+            ++stepped;
+        auto jumped = begin;
+        jumped += 20;
+        EXPECT(stepped == jumped && (*jumped).id() == alive[20]);
+        jumped -= 5;
+        EXPECT((*jumped).id() == alive[15]);
+        std::advance(jumped, -3);
+        EXPECT((*jumped).id() == alive[12]);
+        --jumped;
+        EXPECT((*jumped).id() == alive[11]);
+        EXPECT(begin < jumped && jumped <= end && end > jumped);
+
+        //stepping walks the free ids in both directions
+        bool bForward = true;
+        Size index = 0;
+        for (auto it = begin; it != end; ++it, ++index)
+            bForward = bForward && (*it).id() == alive[index] && it - begin == (std::ptrdiff_t)index;
+        EXPECT(bForward && index == alive.count());
+        bool bBackward = true;
+        for (auto it = end; it != begin;)
+        {
+            --it;
+            --index;
+            bBackward = bBackward && (*it).id() == alive[index] && it == begin + index;
+        }
+        EXPECT(bBackward && index == 0);
+
+        //the range can be split for parallel processing
+        Size counts[4] = {0, 0, 0, 0};
+        std::vector<std::thread> threads;
+        std::ptrdiff_t n = end - begin;
+        for (Size t = 0; t < 4; ++t)
+        {
+            auto from = begin + n * t / 4;
+            auto to = begin + n * (t + 1) / 4;
+            threads.emplace_back([from, to, &counts, t]()
+            {
+                for (auto it = from; it != to; ++it)
+                    counts[t] += (*it).get<Position>().x >= 0.0f;
+            });
+        }
+        for (auto & t : threads)
+            t.join();
+        EXPECT(counts[0] + counts[1] + counts[2] + counts[3] == alive.count());
+
+        const Hub & constHub = hub;
+        EXPECT(std::distance(constHub.begin(), constHub.end()) == (std::ptrdiff_t)alive.count());
+
+        //view sizes
+        EXPECT(hub.view<Position>().size() == alive.count());
+        EXPECT((hub.view<Position, Velocity>().size() == countEntities(hub.view<Position, Velocity>())));
+        EXPECT((hub.view<Velocity, Highlighted>().size() == countEntities(hub.view<Velocity, Highlighted>())));
+        EXPECT(hub.view<Highlighted>().size() == countEntities(hub.view<Highlighted>()));
+        EXPECT(hub.view<Highlighted>().size() == 48);
+
+        //the iterators of several threads share the sorted free list, and iterating does not
+        //change the order in which free ids are reused
+        Entity(entities[50]).destroy();
+        Size expectedSum = 0;
+        for (EntityID id : alive)
+            expectedSum += id == 50 ? 0 : id;
+        Size sums[4] = {0, 0, 0, 0};
+        threads.clear();
+        for (Size t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&constHub, &sums, t]()
+            {
+                for (auto it = constHub.begin(); it != constHub.end(); ++it)
+                    sums[t] += (*it).id();
+            });
+        }
+        for (auto & t : threads)
+            t.join();
+        EXPECT(sums[0] == expectedSum && sums[1] == expectedSum && sums[2] == expectedSum && sums[3] == expectedSum);
+        Size visited = 0;
+        for (Entity e : hub)
+            visited += e.isValid();
+        EXPECT(visited == alive.count() - 1);
+        EXPECT(hub.createEntity().id() == 50);
+
+        Hub empty;
+        EXPECT(empty.begin() == empty.end());
+        EXPECT(empty.view<Position>().size() == 0);
+    },
+    SUITE("Component Buffer Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+
+        Hub hub;
+        auto & positions = hub.componentBuffer<Position>();
+        EXPECT(&positions == &hub.componentBuffer<Position>());
+        EXPECT(!positions.acquire());
+        EXPECT(positions.count() == 0);
+
+        DynamicArray<Entity> entities;
+        for (Size i = 0; i < 300; ++i)
+        {
+            Entity e = hub.createEntity();
+            e.set<Position>((Float32)i, 0.0f, 0.0f);
+            e.set<Name>("a");
+            entities.append(e);
+        }
+        hub.swapBuffers<Position, Name>();
+
+        //writing after the swap does not change the published state
+        for (Entity e : entities)
+            e.get<Position>().y = 1.0f;
+        entities[0].destroy();
+
+        EXPECT(positions.acquire());
+        EXPECT(!positions.acquire());
+        EXPECT(positions.generation() == 1);
+        EXPECT(positions.count() == 300);
+        Float32 sum = 0.0f;
+        bool bUnchanged = true;
+        for (auto item : positions)
+        {
+            sum += item.value.x;
+            bUnchanged = bUnchanged && item.value.y == 0.0f && item.value.x == (Float32)item.entity;
+        }
+        EXPECT(sum == 299.0f * 300.0f / 2.0f);
+        EXPECT(bUnchanged);
+
+        auto & names = hub.componentBuffer<Name>();
+        EXPECT(names.acquire());
+        EXPECT(names.count() == 300);
+        EXPECT((*names.begin()).value == "a");
+
+        hub.swapBuffers<Position>();
+        EXPECT(positions.acquire());
+        EXPECT(positions.generation() == 2);
+        EXPECT(positions.count() == 299);
+
+        {
+            //publishing only copies the pages that changed
+            CountingAllocator counter;
+            Hub other(counter, 4096);
+            DynamicArray<Entity> others;
+            for (Size i = 0; i < 300; ++i)
+            {
+                others.append(other.createEntity());
+                others.last().set<Position>((Float32)i, 0.0f, 0.0f);
+            }
+            auto & buffer = other.componentBuffer<Position>();
+            for (Size i = 0; i < 3; ++i)
+                other.swapBuffers<Position>();
+            Size allocs = counter.allocationCount;
+            other.swapBuffers<Position>();
+            EXPECT(counter.allocationCount == allocs);
+            others[200].get<Position>().y = 5.0f;
+            other.swapBuffers<Position>();
+            EXPECT(counter.allocationCount == allocs + 1);
+            EXPECT(buffer.acquire());
+            EXPECT(buffer.count() == 300);
+            Float32 y = 0.0f;
+            for (auto item : buffer)
+                y += item.value.y;
+            EXPECT(y == 5.0f);
+        }
+
+        //a reader thread always sees a consistent state while the writer keeps publishing
+        std::atomic<bool> bDone(false);
+        std::atomic<bool> bConsistent(true);
+        std::atomic<Size> acquired(0);
+        std::thread reader([&]()
+        {
+            while (!bDone)
+            {
+                if (!positions.acquire())
+                    continue;
+                ++acquired;
+                Float32 expected = (Float32)positions.generation();
+                for (auto item : positions)
+                {
+                    if (item.value.z != expected)
+                        bConsistent = false;
+                }
+            }
+        });
+        for (Size frame = 0; frame < 200; ++frame)
+        {
+            for (Entity e : hub.view<Position>())
+                e.get<Position>().z = (Float32)(frame + 3);
+            hub.swapBuffers<Position>();
+        }
+        bDone = true;
+        reader.join();
+        EXPECT(bConsistent);
+        EXPECT(acquired > 0);
+    },
+    SUITE("Stats Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Velocity = Component<ComponentName("Velocity"), Vec3f>;
+
+        Hub hub;
+        for (Size i = 0; i < 200; ++i)
+        {
+            Entity e = hub.createEntity();
+            e.set<Position>(1.0f, 2.0f, 3.0f);
+            if (i % 10 == 0)
+                e.set<Velocity>(1.0f, 2.0f, 3.0f);
+        }
+        hub.createEntity().destroy();
+
+        HubStats stats = hub.stats();
+        EXPECT(stats.entityCount == 200);
+        EXPECT(stats.freeListCount == 1);
+        EXPECT(stats.entityHighWaterMark == 201);
+        EXPECT(stats.bitsetBytes >= 201 * sizeof(Hub::ComponentBitset));
+        EXPECT(stats.arenaReservedBytes == hub.arena().reservedByteCount());
+        EXPECT(stats.components.count() >= 2);
+
+        const ComponentStats * pos = nullptr;
+        const ComponentStats * vel = nullptr;
+        for (const ComponentStats & cs : stats.components)
+        {
+            if (std::strcmp(cs.name, "Position") == 0)
+                pos = &cs;
+            else if (std::strcmp(cs.name, "Velocity") == 0)
+                vel = &cs;
+        }
+        EXPECT(pos && vel);
+        EXPECT(pos->hash == Position::hash());
+        EXPECT(pos->count == 200);
+        EXPECT(pos->capacity == 256);
+        EXPECT(pos->valueSize == sizeof(Vec3f));
+        EXPECT(pos->bytesUsed == 200 * (sizeof(Vec3f) + sizeof(EntityID) + sizeof(Size)));
+        EXPECT(pos->bytesWasted >= 56 * sizeof(Vec3f));
+        //Velocity is sparse, most of its sparse slots are wasted
+        EXPECT(vel->count == 20);
+        EXPECT(vel->sparseCount >= 191);
+        EXPECT(vel->bytesWasted > pos->bytesWasted);
+
+#ifdef BRICK_ENABLE_COUNTERS
+        EXPECT(stats.counters.createdEntities == 201);
+        EXPECT(stats.counters.destroyedEntities == 1);
+        EXPECT(stats.counters.setComponents == 220);
+        for (auto e : hub.view<Velocity>())
+            (void)e;
+        EXPECT(hub.stats().counters.viewIterations == 20);
+        hub.resetCounters();
+        EXPECT(hub.stats().counters.createdEntities == 0);
+#else
+        EXPECT(stats.counters.createdEntities == 0);
+#endif
+    },
+    SUITE("Trace Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+
+        RecordingTraceSink sink;
+        setTraceSink(&sink);
+        {
+            TraceScope scope("outer");
+        }
+        EXPECT(sink.count("outer") == 1);
+        EXPECT(sink.bOrdered);
+
+        Hub hub;
+        Entity e = hub.createEntity();
+        e.set<Position>(1.0f, 2.0f, 3.0f);
+        for (auto ent : hub.view<Position>())
+            (void)ent;
+        e.removeComponent<Position>();
+        e.destroy();
+        hub.collectGarbage();
+#ifdef BRICK_ENABLE_TRACING
+        EXPECT(sink.count("Hub::createEntity") == 1);
+        EXPECT(sink.count("Hub::setComponent") == 1);
+        EXPECT(sink.count("Hub::view::begin") == 1);
+        EXPECT(sink.count("Hub::removeComponent") == 1);
+        EXPECT(sink.count("Hub::destroyEntity") == 1);
+        EXPECT(sink.count("Hub::collectGarbage") == 1);
+#else
+        EXPECT(sink.names.size() == 1);
+#endif
+        setTraceSink(nullptr);
+        {
+            TraceScope scope("outer");
+        }
+        EXPECT(sink.count("outer") == 1);
+
+        //the chrome sink writes a json object with a traceEvents array
+        const char * path = "BrickTraceTest.json";
+        {
+            ChromeTraceSink chrome(path);
+            EXPECT(chrome.isOpen());
+            chrome.event("a\"b", 1000, 3000, 0);
+            chrome.event("c", 2000, 2500, 1);
+        }
+        std::FILE * f = std::fopen(path, "r");
+        EXPECT(f);
+        char buf[512] = {0};
+        std::fread(buf, 1, sizeof(buf) - 1, f);
+        std::fclose(f);
+        std::remove(path);
+        EXPECT(std::strstr(buf, "{\"traceEvents\":[") == buf);
+        EXPECT(std::strstr(buf, "\"name\":\"a\\\"b\"") != nullptr);
+        EXPECT(std::strstr(buf, "\"ts\":1.000,\"dur\":2.000") != nullptr);
+        EXPECT(std::strstr(buf, "\"tid\":1}") != nullptr);
+        EXPECT(std::strstr(buf, "]}") != nullptr);
+    },
+    SUITE("Component Name Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Velocity = Component<ComponentName("Velocity"), Vec3f>;
+
+        //the hash is known at compile time and only depends on the name
+        static_assert(Position::hash() == detail::fnv1a(detail::FNVOffsetBasis, 'P', 'o', 's', 'i', 't', 'i', 'o', 'n'), "");
+        static_assert(Position::hash() != Velocity::hash(), "");
+        //64 bit FNV-1a of "Position", stable across builds
+        EXPECT(Position::hash() == 0xc1611c0558728a2aull);
+        EXPECT(std::strcmp(Position::cString(), "Position") == 0);
+        EXPECT(Position::name() == "Position");
+
+        Hub hub;
+        Entity e = hub.createEntity();
+        e.set<Position>(1.0f, 2.0f, 3.0f);
+        e.set<Velocity>(1.0f, 2.0f, 3.0f);
+        Size count = 0;
+        for (auto ent : hub.view<Position, Velocity>())
+            ++count;
+        EXPECT(count == 1);
+    },
+    SUITE("Scheduler Tests")
+    {
+        using Position = Component<ComponentName("Position"), Vec3f>;
+        using Velocity = Component<ComponentName("Velocity"), Vec3f>;
+        using Name = Component<ComponentName("Name"), String>;
+
+        Hub hub;
+        for (Size i = 0; i < 100; ++i)
+        {
+            Entity e = hub.createEntity();
+            e.set<Position>(0.0f, 0.0f, 0.0f);
+            e.set<Velocity>(1.0f, 2.0f, 3.0f);
+            if (i % 2 == 0)
+                e.set<Name>("Eggbert");
+        }
+
+        SystemAccess a = FunctionSystem<Read<Velocity>, Write<Position>>([](Hub &) {}).access(hub);
+        SystemAccess b = FunctionSystem<Read<Velocity>>([](Hub &) {}).access(hub);
+        SystemAccess c = FunctionSystem<Read<Position>>([](Hub &) {}).access(hub);
+        SystemAccess d = FunctionSystem<Exclusive>([](Hub &) {}).access(hub);
+        EXPECT(!a.conflictsWith(b));
+        EXPECT(a.conflictsWith(c));
+        EXPECT(c.conflictsWith(a));
+        EXPECT(!b.conflictsWith(c));
+        EXPECT(d.conflictsWith(b));
+
+        std::atomic<Size> moved(0), named(0), checked(0);
+        Scheduler scheduler(hub, 3);
+        scheduler.addFunction<Read<Velocity>, Write<Position>>([&](Hub & _hub)
+        {
+            for (Entity e : _hub.view<Position, Velocity>())
+            {
+                e.get<Position>().x += e.get<Velocity>().x;
+                moved++;
+            }
+        });
+        scheduler.addFunction<Read<Name>>([&](Hub & _hub)
+        {
+            for (Entity e : _hub.view<Name>())
+                named++;
+        });
+        scheduler.addFunction<Read<Position>>([&](Hub & _hub)
+        {
+            //must run after the movement system
+            for (Entity e : _hub.view<Position>())
+            {
+                if (e.get<Position>().x == 1.0f)
+                    checked++;
+            }
+        });
+        EXPECT(scheduler.systemCount() == 3);
+        EXPECT(scheduler.workerCount() == 3);
+        scheduler.run();
+        EXPECT(moved == 100);
+        EXPECT(named == 50);
+        EXPECT(checked == 100);
+
+        Scheduler serial(hub, 0);
+        serial.addFunction<Write<Position>>([](Hub & _hub)
+        {
+            for (Entity e : _hub.view<Position>())
+                e.get<Position>().x = 0.0f;
+        });
+        serial.run();
+        serial.run();
+        for (Entity e : hub.view<Position>())
+            EXPECT(e.get<Position>().x == 0.0f);
+
+        //readers still only read after a snapshot shared the pages of their components
+        Hub::Snapshot snapshot = hub.snapshot();
+        std::atomic<Size> read(0);
+        Scheduler readers(hub, 2);
+        for (Size i = 0; i < 2; ++i)
+        {
+            readers.addFunction<Read<Position>>([&](Hub & _hub)
+            {
+                for (Entity e : _hub.view<Position>())
+                    read += e.get<Position>().x == 0.0f;
+            });
+        }
+        readers.run();
+        EXPECT(read == 200);
     }
 };
 